@@ -30,7 +30,7 @@ TABSTOP = 8
 # the object files which make up your drivers.
 ##################################################
 #
-COMMON_OBJS = console.o handler_install.o timer_handler.o kbd_handler.o timer.o kbd.o
+COMMON_OBJS = console.o handler_install.o timer_handler.o kbd_handler.o scancode.o timer.o kbd.o cells.o idle.o latency.o timer_wheel.o deferred.o clock.o div64.o
 
 ##################################################
 # Object files from 410kern/ for just the game
@@ -47,7 +47,7 @@ COMMON_OBJS = console.o handler_install.o timer_handler.o kbd_handler.o timer.o
 # multiple parts.
 ##################################################
 #
-KERN_GAME_OBJS = game.o game_controller.o
+KERN_GAME_OBJS = game.o game_controller.o board.o hint.o autoplay.o mcts.o history.o
 
 ##################################################
 # Object files from 410kern/ for just the tester
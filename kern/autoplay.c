@@ -0,0 +1,150 @@
+/** @file autoplay.c
+ *  @brief the beam search autoplayer
+ *
+ *  Each state carries its board together with its labeled regions,
+ *  so the moves out of a state are read off its region table, and a
+ *  child costs a copy, one removal and a relabel of the columns the
+ *  move touched. Children are first scored as candidates without
+ *  being built, and only the best AUTOPLAY_BEAM of them are.
+ *
+ *  The states live in static tables, since a beam of them is far
+ *  larger than the kernel stack.
+ *
+ *  @author Sohil Habib (snhabib)
+ *  @bug No known bugs.
+ */
+
+/* necessary includes */
+#include <stdint.h>
+#include <simics.h>
+#include <timer_handler.h>
+#include <deferred.h>
+#include <clock.h>
+#include <div64.h>
+#include <hint.h>
+#include <autoplay.h>
+
+/** @brief a state of the search */
+typedef struct beam_state {
+  play_state_t play;
+  /* the move that left the root on the way here */
+  board_move_t first;
+} beam_state_t;
+
+/** @brief a move out of a state, scored but not yet played */
+typedef struct candidate {
+  /* the state moved from */
+  uint8_t parent;
+  /* the region cleared */
+  uint8_t id;
+  int score;
+} candidate_t;
+
+/* the states of the current depth and the next */
+static beam_state_t beams[2][AUTOPLAY_BEAM];
+
+/* the best candidates of a depth, best first */
+static candidate_t best[AUTOPLAY_BEAM];
+
+/* states built since the last report */
+static unsigned int num_states;
+
+/* time spent searching since the last report */
+static uint64_t search_ns;
+
+/** @brief keeps the best candidates out of a depth's states
+ *
+ *  @param states The states
+ *  @param n The number of states
+ *  @return int the number of candidates kept
+ */
+static int pick_candidates(const beam_state_t *states,int n)
+{
+  const play_state_t *s;
+  board_move_t m;
+  candidate_t cand;
+  int i,id,j,kept=0;
+  for(i=0;i<n;i++) {
+    s=&states[i].play;
+    for(id=0;id<BOARD_MAX_REGIONS;id++) {
+      if(s->regions.size[id]<2)
+        continue;
+      board_region_move(&s->regions,id,&m);
+      cand.parent=i;
+      cand.id=id;
+      cand.score=s->score+hint_score(&m,s->last_color,s->combo_multiplier);
+      if(kept==AUTOPLAY_BEAM && cand.score<=best[kept-1].score)
+        continue;
+      if(kept<AUTOPLAY_BEAM)
+        kept++;
+      for(j=kept-1;j>0 && best[j-1].score<cand.score;j--)
+        best[j]=best[j-1];
+      best[j]=cand;
+    }
+  }
+  return kept;
+}
+
+/** @brief plays a candidate into a new state
+ *
+ *  @param parent The state moved from
+ *  @param cand The candidate
+ *  @param child Where to build the new state
+ *  @return Void.
+ */
+static void play_candidate(const beam_state_t *parent,const candidate_t *cand,
+                           beam_state_t *child)
+{
+  *child=*parent;
+  hint_play(&child->play,cand->id);
+  num_states++;
+}
+
+int autoplay_search(const board_t *b,const board_regions_t *r,
+                    int last_color,int combo_multiplier,
+                    unsigned int budget,board_move_t *move)
+{
+  unsigned int start=get_ticks();
+  uint64_t start_ns=clock_ns();
+  beam_state_t *cur=beams[0],*next=beams[1],*tmp;
+  int i,n=1,depth,best_score=-1;
+
+  if(!r->num_moves)
+    return 0;
+  cur[0].play.board=*b;
+  cur[0].play.regions=*r;
+  cur[0].play.score=0;
+  cur[0].play.last_color=last_color;
+  cur[0].play.combo_multiplier=combo_multiplier;
+  for(depth=0;;depth++) {
+    n=pick_candidates(cur,n);
+    if(!n)
+      break;
+    for(i=0;i<n;i++) {
+      play_candidate(&cur[best[i].parent],&best[i],&next[i]);
+      if(!depth)
+        board_region_move(&cur[0].play.regions,best[i].id,&next[i].first);
+      // scores only grow, so the best line ends in the best state
+      if(next[i].play.score>best_score) {
+        best_score=next[i].play.score;
+        *move=next[i].first;
+      }
+    }
+    tmp=cur;cur=next;next=tmp;
+    // keys and clock redraws must not wait for the whole search
+    run_deferred();
+    if(get_ticks()-start>=budget)
+      break;
+  }
+  search_ns+=clock_ns()-start_ns;
+  return 1;
+}
+
+void autoplay_report()
+{
+  unsigned int us=div64_32(search_ns,1000);
+  sim_printf("autoplay: %u states in %u us, %u states/s",num_states,us,
+             us ? (unsigned int)div64_32((uint64_t)num_states*1000000,us) : 0);
+  num_states=0;
+  search_ns=0;
+}
@@ -0,0 +1,39 @@
+/** @file autoplay.h
+ *  @brief function definitions for the autoplayer
+ *
+ *  The autoplayer picks moves by a beam search over board states,
+ *  scoring each state by the points its moves earned under the rule
+ *  game_start scores with. The search deepens one move at a time
+ *  until the game ends or its budget of timer ticks runs out.
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+#include <board.h>
+
+/* number of states kept at each depth of the search */
+#define AUTOPLAY_BEAM 16
+
+/** @brief searches for the next move to play
+ *
+ *  @param b The board
+ *  @param r The regions of the board
+ *  @param last_color The color id of the region last cleared, -1 if none
+ *  @param combo_multiplier The current combo multiplier
+ *  @param budget The number of timer ticks the search may take; it
+ *         always goes at least one move deep
+ *  @param move Where to store the first move of the best line found
+ *  @return int nonzero if a move was found, 0 if the game is over
+ */
+int autoplay_search(const board_t *b,const board_regions_t *r,
+                    int last_color,int combo_multiplier,
+                    unsigned int budget,board_move_t *move);
+
+/** @brief logs what the searches since the last report have done
+ *
+ *  Gives the states expanded and the rate, which makes autoplay a
+ *  benchmark of the board's copy, labeling and removal paths.
+ *
+ *  @return Void.
+ */
+void autoplay_report();
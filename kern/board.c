@@ -0,0 +1,350 @@
+/** @file board.c
+ *  @brief the game board and the moves on it
+ *
+ *  Everything here works a column mask at a time. Gravity squeezes
+ *  the gaps out of each color's mask, and a removal reports the
+ *  columns it changed so that only those are labeled again.
+ *
+ *  Labeling cuts each column into runs of one color, which are the
+ *  contiguous stretches of a mask, and joins the runs that overlap
+ *  across neighboring columns with a union-find, so the whole board
+ *  is labeled in one pass over its columns.
+ *
+ *  @author Sohil Habib (snhabib)
+ *  @bug No known bugs.
+ */
+
+/* necessary includes */
+#include <stdint.h>
+#include <string.h>
+#include <board.h>
+
+/** @brief counts the set bits of a column mask
+ *
+ *  @param x The mask
+ *  @return int the number of bits set
+ */
+static int popcount(unsigned int x)
+{
+  x=x-((x>>1) & 0x55555555);
+  x=(x & 0x33333333)+((x>>2) & 0x33333333);
+  x=(x+(x>>4)) & 0x0F0F0F0F;
+  return (x*0x01010101)>>24;
+}
+
+/** @brief returns the occupancy mask of a column
+ *
+ *  @param b The board
+ *  @param col The column
+ *  @return unsigned the mask of the places holding a block
+ */
+static unsigned int occupied(const board_t *b,int col)
+{
+  unsigned int occ=0;
+  int k;
+  for(k=0;k<BOARD_COLORS;k++)
+    occ|=b->cols[k][col];
+  return occ;
+}
+
+void board_clear(board_t *b)
+{
+  memset(b,0,sizeof(*b));
+}
+
+int board_get(const board_t *b,int row,int col)
+{
+  int k;
+  for(k=0;k<BOARD_COLORS;k++)
+    if(b->cols[k][col] & BOARD_BIT(row))
+      return k;
+  return BOARD_EMPTY;
+}
+
+void board_set(board_t *b,int row,int col,int color)
+{
+  int k;
+  for(k=0;k<BOARD_COLORS;k++)
+    b->cols[k][col]&=~BOARD_BIT(row);
+  if(color!=BOARD_EMPTY)
+    b->cols[color][col]|=BOARD_BIT(row);
+}
+
+unsigned int board_remove(board_t *b,const uint16_t *region)
+{
+  unsigned int changed=0;
+  unsigned int occ,bit,packed[BOARD_COLORS];
+  int c,k,w,j;
+  // block falling logic, squeezing the gaps out of each color's mask
+  for(c=0;c<BOARD_COLS;c++) {
+    if(!region[c])
+      continue;
+    changed|=1<<c;
+    for(k=0;k<BOARD_COLORS;k++) {
+      b->cols[k][c]&=~region[c];
+      packed[k]=0;
+    }
+    occ=occupied(b,c);
+    for(j=0;occ;occ&=occ-1,j++) {
+      bit=occ & -occ;
+      for(k=0;k<BOARD_COLORS;k++)
+        if(b->cols[k][c] & bit)
+          packed[k]|=1<<j;
+    }
+    for(k=0;k<BOARD_COLORS;k++)
+      b->cols[k][c]=packed[k];
+  }
+  // column compaction, moving the columns right over empty ones
+  w=BOARD_COLS-1;
+  for(c=BOARD_COLS-1;c>=0;c--) {
+    if(!occupied(b,c))
+      continue;
+    if(w!=c) {
+      for(k=0;k<BOARD_COLORS;k++) {
+        b->cols[k][w]=b->cols[k][c];
+        b->cols[k][c]=0;
+      }
+      changed|=(1<<w)|(1<<c);
+    }
+    w--;
+  }
+  return changed;
+}
+
+unsigned int board_kept(const board_t *b,const uint16_t *region)
+{
+  unsigned int kept=0;
+  int c;
+  for(c=0;c<BOARD_COLS;c++)
+    if(occupied(b,c) & ~region[c])
+      kept|=1<<c;
+  return kept;
+}
+
+unsigned int board_restore(board_t *b,const uint16_t *region,int color,
+                           unsigned int kept)
+{
+  uint16_t after[BOARD_COLORS][BOARD_COLS];
+  unsigned int changed=0,dest,d,packed,out;
+  int c,k,w,j;
+  memcpy(after,b->cols,sizeof(after));
+  memset(b->cols,0,sizeof(b->cols));
+  // the kept columns ended up, in order, at the right end
+  w=BOARD_COLS-popcount(kept);
+  for(c=0;c<BOARD_COLS;c++) {
+    if(!(kept & (1<<c)))
+      continue;
+    for(k=0;k<BOARD_COLORS;k++)
+      b->cols[k][c]=after[k][w];
+    w++;
+  }
+  // columns are always packed from the bottom, so the blocks that
+  // fell go back to the places the region leaves free below the top
+  for(c=0;c<BOARD_COLS;c++) {
+    if(!region[c])
+      continue;
+    dest=((1<<(popcount(occupied(b,c))+popcount(region[c])))-1) & ~region[c];
+    for(k=0;k<BOARD_COLORS;k++) {
+      packed=b->cols[k][c];
+      out=0;
+      for(d=dest,j=0;d;d&=d-1,j++)
+        if(packed & (1<<j))
+          out|=d & -d;
+      b->cols[k][c]=out;
+    }
+    b->cols[color][c]|=region[c];
+  }
+  for(c=0;c<BOARD_COLS;c++)
+    for(k=0;k<BOARD_COLORS;k++)
+      if(b->cols[k][c]!=after[k][c])
+        changed|=1<<c;
+  return changed;
+}
+
+int board_region_count(const uint16_t *region)
+{
+  int c,n=0;
+  for(c=0;c<BOARD_COLS;c++)
+    n+=popcount(region[c]);
+  return n;
+}
+
+/** @brief finds the root of a run's set
+ *
+ *  @param parent The parent of each run
+ *  @param x The run
+ *  @return int the root run
+ */
+static int find_run(uint8_t *parent,int x)
+{
+  while(parent[x]!=x) {
+    parent[x]=parent[parent[x]];
+    x=parent[x];
+  }
+  return x;
+}
+
+/** @brief takes a region id off the free list
+ *
+ *  @param r The regions
+ *  @return int the id
+ */
+static int alloc_region(board_regions_t *r)
+{
+  return r->free_ids[--r->num_free];
+}
+
+/** @brief puts a region id back on the free list
+ *
+ *  @param r The regions
+ *  @param id The id
+ *  @return Void.
+ */
+static void free_region(board_regions_t *r,int id)
+{
+  if(r->size[id]>=2)
+    r->num_moves--;
+  r->size[id]=0;
+  r->free_ids[r->num_free++]=id;
+}
+
+/** @brief labels the selected blocks of a board
+ *
+ *  Joining a run only with the overlapping runs of the previous
+ *  column finds every adjacency, since runs of one color in one
+ *  column never touch. A set's root is always its first run, so
+ *  ids are handed out in a single pass over the runs.
+ *
+ *  @param b The board
+ *  @param r The regions, with the selected places unlabeled
+ *  @param sel The places to label, as one mask per column; these
+ *         must hold whole regions
+ *  @return Void.
+ */
+static void label_runs(const board_t *b,board_regions_t *r,
+                       const uint16_t *sel)
+{
+  uint16_t bits[BOARD_MAX_REGIONS];
+  uint8_t col[BOARD_MAX_REGIONS],color[BOARD_MAX_REGIONS];
+  uint8_t parent[BOARD_MAX_REGIONS],ids[BOARD_MAX_REGIONS];
+  unsigned int m,run;
+  int c,k,i,j,x,y,id,n=0,prev=0,start;
+  for(c=0;c<BOARD_COLS;c++) {
+    start=n;
+    for(k=0;k<BOARD_COLORS;k++) {
+      for(m=b->cols[k][c] & sel[c];m;m&=~run) {
+        run=m & ~(m+(m & -m));
+        bits[n]=run;
+        col[n]=c;
+        color[n]=k;
+        parent[n]=n;
+        for(j=prev;j<start;j++) {
+          if(color[j]!=k || !(bits[j] & run))
+            continue;
+          x=find_run(parent,n);
+          y=find_run(parent,j);
+          if(x<y)
+            parent[y]=x;
+          else
+            parent[x]=y;
+        }
+        n++;
+      }
+    }
+    prev=start;
+  }
+  for(i=0;i<n;i++) {
+    x=find_run(parent,i);
+    if(x==i) {
+      id=alloc_region(r);
+      r->color[id]=color[i];
+      r->row[id]=BOARD_ROW(__builtin_ctz(bits[i]));
+      r->col[id]=col[i];
+      ids[i]=id;
+    }
+    else
+      id=ids[i]=ids[x];
+    r->size[id]+=popcount(bits[i]);
+    for(m=bits[i];m;m&=m-1)
+      r->id[BOARD_ROW(__builtin_ctz(m))][col[i]]=id;
+  }
+  for(i=0;i<n;i++)
+    if(parent[i]==i && r->size[ids[i]]>=2)
+      r->num_moves++;
+}
+
+void board_label(const board_t *b,board_regions_t *r)
+{
+  uint16_t sel[BOARD_COLS];
+  int i;
+  memset(r->id,BOARD_NO_REGION,sizeof(r->id));
+  memset(r->size,0,sizeof(r->size));
+  for(i=0;i<BOARD_MAX_REGIONS;i++)
+    r->free_ids[i]=BOARD_MAX_REGIONS-1-i;
+  r->num_free=BOARD_MAX_REGIONS;
+  r->num_moves=0;
+  memset(sel,0xFF,sizeof(sel));
+  label_runs(b,r,sel);
+}
+
+void board_relabel(const board_t *b,board_regions_t *r,unsigned int cols)
+{
+  uint16_t sel[BOARD_COLS];
+  uint8_t dirty[BOARD_MAX_REGIONS];
+  unsigned int near=cols|(cols<<1)|(cols>>1);
+  int row,c,id;
+  // a region far from the changed columns neither lost a block
+  // nor gained a neighbor of its color, so it stays as it is
+  memset(dirty,0,sizeof(dirty));
+  for(c=0;c<BOARD_COLS;c++) {
+    if(!(near & (1<<c)))
+      continue;
+    for(row=0;row<BOARD_ROWS;row++) {
+      id=r->id[row][c];
+      if(id!=BOARD_NO_REGION && !dirty[id]) {
+        dirty[id]=1;
+        free_region(r,id);
+      }
+    }
+  }
+  for(c=0;c<BOARD_COLS;c++) {
+    sel[c]=0;
+    for(row=0;row<BOARD_ROWS;row++) {
+      id=r->id[row][c];
+      if((cols & (1<<c)) || (id!=BOARD_NO_REGION && dirty[id])) {
+        r->id[row][c]=BOARD_NO_REGION;
+        sel[c]|=BOARD_BIT(row);
+      }
+    }
+  }
+  label_runs(b,r,sel);
+}
+
+int board_region_size(const board_regions_t *r,int row,int col)
+{
+  int id=r->id[row][col];
+  return id==BOARD_NO_REGION ? 0 : r->size[id];
+}
+
+void board_region_move(const board_regions_t *r,int id,board_move_t *m)
+{
+  m->row=r->row[id];
+  m->col=r->col[id];
+  m->color=r->color[id];
+  m->size=r->size[id];
+}
+
+int board_region_mask(const board_regions_t *r,int row,int col,
+                      uint16_t *region)
+{
+  int id=r->id[row][col];
+  int i,c;
+  memset(region,0,BOARD_COLS*sizeof(region[0]));
+  if(id==BOARD_NO_REGION)
+    return 0;
+  for(c=0;c<BOARD_COLS;c++)
+    for(i=0;i<BOARD_ROWS;i++)
+      if(r->id[i][c]==id)
+        region[c]|=BOARD_BIT(i);
+  return r->size[id];
+}
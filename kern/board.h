@@ -0,0 +1,206 @@
+/** @file board.h
+ *  @brief the game board and the moves on it
+ *
+ *  The board keeps one occupancy mask per color and column. Bit
+ *  BOARD_BIT(row) of cols[k][c] is set when the block at (row,c) has
+ *  color k; rows count from the top, as on the screen, but the masks
+ *  count from the bottom so that blocks fall towards bit 0. Colors
+ *  are small ids, turned into screen attributes only when drawn.
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+
+/* number of rows on the board */
+#define BOARD_ROWS 10
+
+/* number of columns on the board */
+#define BOARD_COLS 15
+
+/* number of block colors */
+#define BOARD_COLORS 3
+
+/* the color id of an empty place */
+#define BOARD_EMPTY -1
+
+/* the mask bit of a row */
+#define BOARD_BIT(row) (1<<(BOARD_ROWS-1-(row)))
+
+/* the row of a mask bit */
+#define BOARD_ROW(bit) (BOARD_ROWS-1-(bit))
+
+/* the most moves a board can offer, each taking two blocks or more */
+#define BOARD_MAX_MOVES (BOARD_ROWS*BOARD_COLS/2)
+
+/* the most regions a board can hold */
+#define BOARD_MAX_REGIONS (BOARD_ROWS*BOARD_COLS)
+
+/* the region id of an empty place */
+#define BOARD_NO_REGION 0xFF
+
+/** @brief the game board */
+typedef struct board {
+  /* occupancy masks, per color and column */
+  uint16_t cols[BOARD_COLORS][BOARD_COLS];
+} board_t;
+
+/** @brief a move: one block of a region that can be removed */
+typedef struct board_move {
+  uint8_t row;
+  uint8_t col;
+  /* the color id of the region */
+  uint8_t color;
+  /* the number of blocks in the region */
+  uint8_t size;
+} board_move_t;
+
+/** @brief the regions of a board, labeled
+ *
+ *  Region ids index the per-region tables, whose entries for ids
+ *  not in use have size 0.
+ */
+typedef struct board_regions {
+  /* the region id of each place, BOARD_NO_REGION if empty */
+  uint8_t id[BOARD_ROWS][BOARD_COLS];
+  /* the number of blocks of each region */
+  uint8_t size[BOARD_MAX_REGIONS];
+  /* the color id of each region */
+  uint8_t color[BOARD_MAX_REGIONS];
+  /* the place of one block of each region */
+  uint8_t row[BOARD_MAX_REGIONS];
+  uint8_t col[BOARD_MAX_REGIONS];
+  /* the ids not in use */
+  uint8_t free_ids[BOARD_MAX_REGIONS];
+  int num_free;
+  /* the number of regions of two blocks or more */
+  int num_moves;
+} board_regions_t;
+
+/** @brief empties a board
+ *
+ *  @param b The board
+ *  @return Void.
+ */
+void board_clear(board_t *b);
+
+/** @brief returns the color of a block
+ *
+ *  @param b The board
+ *  @param row The row of the block
+ *  @param col The column of the block
+ *  @return int the color id, BOARD_EMPTY if there is no block
+ */
+int board_get(const board_t *b,int row,int col);
+
+/** @brief places a block on the board
+ *
+ *  @param b The board
+ *  @param row The row of the block
+ *  @param col The column of the block
+ *  @param color The color id, or BOARD_EMPTY to remove the block
+ *  @return Void.
+ */
+void board_set(board_t *b,int row,int col,int color);
+
+/** @brief removes a region and lets the rest of the board settle
+ *
+ *  The blocks above the region fall into the gaps, and then the
+ *  columns move right over the empty ones.
+ *
+ *  @param b The board
+ *  @param region The region to remove, as found by board_region_mask
+ *  @return unsigned a mask of the columns that changed, bit c
+ *          standing for column c
+ */
+unsigned int board_remove(board_t *b,const uint16_t *region);
+
+/** @brief returns the columns left holding blocks by a removal
+ *
+ *  These are the columns board_remove moves right, in order, over
+ *  the emptied ones; with the region they are all it takes to undo
+ *  the removal.
+ *
+ *  @param b The board, before the removal
+ *  @param region The region to be removed
+ *  @return unsigned a mask of the columns, bit c standing for column c
+ */
+unsigned int board_kept(const board_t *b,const uint16_t *region);
+
+/** @brief puts a removed region back
+ *
+ *  Undoes board_remove: the columns it moved go back, and the
+ *  blocks that fell over the region are lifted back above it.
+ *
+ *  @param b The board, after the removal
+ *  @param region The region that was removed
+ *  @param color The color id of the region
+ *  @param kept The columns board_kept returned before the removal
+ *  @return unsigned a mask of the columns that changed, bit c
+ *          standing for column c
+ */
+unsigned int board_restore(board_t *b,const uint16_t *region,int color,
+                           unsigned int kept);
+
+/** @brief returns the number of blocks in a region
+ *
+ *  @param region The region, as one mask per column
+ *  @return int the number of blocks
+ */
+int board_region_count(const uint16_t *region);
+
+/** @brief labels every region of a board
+ *
+ *  @param b The board
+ *  @param r Where to store the regions
+ *  @return Void.
+ */
+void board_label(const board_t *b,board_regions_t *r);
+
+/** @brief brings the regions up to date after a move
+ *
+ *  Only the regions in or next to the changed columns are labeled
+ *  again; the others keep their ids.
+ *
+ *  @param b The board, after the move
+ *  @param r The regions of the board before the move
+ *  @param cols The changed columns, as returned by board_remove
+ *  @return Void.
+ */
+void board_relabel(const board_t *b,board_regions_t *r,unsigned int cols);
+
+/** @brief returns the size of the region of a block
+ *
+ *  @param r The regions
+ *  @param row The row of the block
+ *  @param col The column of the block
+ *  @return int the number of blocks in the region, 0 if the place
+ *          is empty
+ */
+int board_region_size(const board_regions_t *r,int row,int col);
+
+/** @brief describes the move that clears a region
+ *
+ *  @param r The regions
+ *  @param id The region
+ *  @param m Where to store the move
+ *  @return Void.
+ */
+void board_region_move(const board_regions_t *r,int id,board_move_t *m);
+
+/** @brief finds the places of the region of a block
+ *
+ *  @param r The regions
+ *  @param row The row of the block
+ *  @param col The column of the block
+ *  @param region Where to store the region, as one mask per column
+ *  @return int the number of blocks in the region, 0 if the place
+ *          is empty
+ */
+int board_region_mask(const board_regions_t *r,int row,int col,
+                      uint16_t *region);
+
+#endif /* BOARD_H */
@@ -0,0 +1,25 @@
+/** @file cells.h
+ *  @brief function definition for the bulk screen cell routines
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+#include <stdint.h>
+
+/** @brief cellcpy copies screen cells with a single rep movsw
+ *
+ *  @param dst The first cell to write
+ *  @param src The first cell to read
+ *  @param n The number of cells to copy
+ *  @return Void.
+ */
+void cellcpy(uint16_t *dst,const uint16_t *src,int n);
+
+/** @brief cellset fills screen cells with a single rep stosw
+ *
+ *  @param dst The first cell to write
+ *  @param cell The cell value to store
+ *  @param n The number of cells to fill
+ *  @return Void.
+ */
+void cellset(uint16_t *dst,uint16_t cell,int n);
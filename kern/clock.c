@@ -0,0 +1,116 @@
+/** @file clock.c
+ *  @brief the file contains the high resolution clock
+ *
+ *  Calibration lets PIT counter 2, the speaker counter, count down a
+ *  known number of PIT cycles in one-shot mode and times it with the
+ *  time stamp counter. Counter 0 keeps running the timer interrupt
+ *  undisturbed, and since the end of the count is seen on a port
+ *  instead of through an interrupt, calibration works before the
+ *  interrupts are enabled.
+ *
+ *  Cycles are turned into nanoseconds by a multiply and a shift,
+ *  with mult/2^shift the length of a cycle in nanoseconds.
+ *
+ *  @author Sohil Habib (snhabib)
+ *  @bug No known bugs.
+ */
+
+/* necessary includes */
+#include <stdint.h>
+#include <simics.h>
+#include <x86/asm.h>
+#include <x86/timer_defines.h>
+#include <timer_handler.h>
+#include <div64.h>
+#include <clock.h>
+
+/* data port of PIT counter 2 */
+#define PIT_CH2_PORT 0x42
+
+/* system control port holding the counter 2 gate and output */
+#define PIT_CH2_CTL_PORT 0x61
+
+/* system control bits */
+#define PIT_CH2_GATE 0x01
+#define PIT_CH2_SPEAKER 0x02
+#define PIT_CH2_OUT 0x20
+
+/* mode command: counter 2, both bytes, one-shot */
+#define PIT_CH2_ONE_SHOT 0xB0
+
+/* PIT cycles timed by the calibration, about 50 ms */
+#define CAL_COUNTS 59659
+
+/* polls of the counter output before calibration gives up */
+#define CAL_POLLS (1<<24)
+
+#define NS_PER_SEC 1000000000
+
+/* the time stamp counter at clock_init */
+static uint64_t tsc_base;
+
+/* length of a cycle in nanoseconds, times 2^shift */
+static uint32_t mult;
+static int shift;
+
+/* nonzero once the time stamp counter has been calibrated */
+static int is_calibrated;
+
+/* the clock_ns value last returned by the tick fallback */
+static uint64_t last_ns;
+
+void clock_init()
+{
+  uint64_t cycles;
+  uint32_t window_ns;
+  unsigned int polls;
+  int ctl=inb(PIT_CH2_CTL_PORT);
+
+  // gate the counter on with the speaker off, then load the count
+  outb(PIT_CH2_CTL_PORT,(ctl & ~PIT_CH2_SPEAKER) | PIT_CH2_GATE);
+  outb(TIMER_MODE_IO_PORT,PIT_CH2_ONE_SHOT);
+  outb(PIT_CH2_PORT,CAL_COUNTS&0xFF);
+  outb(PIT_CH2_PORT,(CAL_COUNTS&0xFF00)>>8);
+  tsc_base=rdtsc();
+  for(polls=0;polls<CAL_POLLS && !(inb(PIT_CH2_CTL_PORT) & PIT_CH2_OUT);polls++);
+  cycles=rdtsc()-tsc_base;
+  outb(PIT_CH2_CTL_PORT,ctl);
+
+  window_ns=div64_32((uint64_t)CAL_COUNTS*NS_PER_SEC,TIMER_RATE);
+  if(polls==CAL_POLLS || !cycles || cycles>>32) {
+    sim_printf("clock: tsc calibration failed, using timer ticks");
+    return;
+  }
+  // the largest shift that keeps mult within 32 bits
+  for(shift=32;shift && (((uint64_t)window_ns<<shift)>>32)>=cycles;shift--);
+  mult=div64_32((uint64_t)window_ns<<shift,cycles);
+  is_calibrated=1;
+  sim_printf("clock: tsc runs at %u kHz",
+             (unsigned int)div64_32(cycles*1000000,window_ns));
+}
+
+uint64_t clock_cycles_ns(uint64_t cycles)
+{
+  uint32_t hi=cycles>>32;
+  uint32_t lo=cycles;
+  if(!is_calibrated)
+    return 0;
+  return (((uint64_t)hi*mult)<<(32-shift)) + (((uint64_t)lo*mult)>>shift);
+}
+
+uint64_t clock_ns()
+{
+  uint64_t ns;
+  unsigned int rate;
+  if(is_calibrated)
+    return clock_cycles_ns(rdtsc()-tsc_base);
+  // no tick has been counted before the timer is given a rate
+  rate=timer_get_rate();
+  if(!rate)
+    return last_ns;
+  // a change of the tick rate must not move the clock backwards
+  ns=(uint64_t)get_ticks()*(NS_PER_SEC/rate);
+  if(ns>last_ns)
+    last_ns=ns;
+  return last_ns;
+}
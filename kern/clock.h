@@ -0,0 +1,38 @@
+/** @file clock.h
+ *  @brief function definition for the high resolution clock
+ *
+ *  The clock reads the time stamp counter, which is calibrated
+ *  against the PIT once at boot, so reading it takes no port I/O.
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+#include <stdint.h>
+
+/** @brief calibrates the time stamp counter and starts the clock
+ *
+ *  Times a fixed count of PIT counter 2 with the time stamp counter,
+ *  which takes about 50 ms. If counter 2 cannot be used the clock
+ *  falls back to the timer ticks. Must be called with interrupts
+ *  disabled.
+ *
+ *  @return Void.
+ */
+void clock_init();
+
+/** @brief returns the time since clock_init in nanoseconds
+ *
+ *  The time never goes backwards. On the timer tick fallback it
+ *  stays 0 until the timer has been given a rate.
+ *
+ *  @return uint64_t the time in nanoseconds
+ */
+uint64_t clock_ns();
+
+/** @brief converts a number of time stamp counter cycles to nanoseconds
+ *
+ *  @param cycles The number of cycles
+ *  @return uint64_t the same time in nanoseconds, 0 if the time stamp
+ *          counter could not be calibrated
+ */
+uint64_t clock_cycles_ns(uint64_t cycles);
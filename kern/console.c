@@ -5,144 +5,594 @@
  *  as per the declarations in p1kern.h. All the function details
  *  are specified in the p1kern.h file
  *
+ *  Drawing is done into an off-screen shadow of the display
+ *  which remembers, for every row, the span of cells changed since
+ *  the last flush. console_flush() copies only those spans to the
+ *  VGA memory. Unless a caller has asked for deferred updates with
+ *  console_defer(), every api call flushes before returning, so the
+ *  screen always matches the p1kern.h contract.
+ *
+ *  A screen cell is handled as one 16-bit value throughout, and spans
+ *  of cells are moved with rep movsw/rep stosw (cells.S). Besides the
+ *  p1kern.h calls, draw_cells() and fill_cells() draw whole spans.
+ *
+ *  There are NUM_CONSOLES virtual consoles, each with its own shadow,
+ *  cursor, color and history, and each owning an equal slice of the
+ *  32k VGA text aperture. The p1kern.h calls draw into the console
+ *  picked by console_select(); console_switch() decides which one is
+ *  on the screen. Every console is flushed into its own slice whether
+ *  it is shown or not, so switching is just a new CRTC start address.
+ *
+ *  Scrolling never moves text around. The shadow is a ring of rows
+ *  and the visible window slides down the console's slice of the
+ *  aperture by reprogramming the CRTC start address; only when the
+ *  window runs off the end of the slice is the screen copied back to
+ *  the top.
+ *
+ *  The CRTC registers are slow port I/O, so the driver remembers what
+ *  it last wrote to each of them and only touches the ones whose value
+ *  changes. The cursor and window registers are programmed once per
+ *  flush rather than on every set_cursor().
+ *
+ *  Rows scrolled off the top are kept in a history ring allocated
+ *  from malloc_lmm. console_view_scroll() pages back through it by
+ *  drawing whole rows straight into the window; output continues into
+ *  the shadow meanwhile and reappears when the live view is restored.
+ *
  *  @author Sohil Habib (snhabib)
  *  @bug No known bugs.
  */
 
 #include <p1kern.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <video_defines.h>
 #include <x86/asm.h>
 #include <string.h>
+#include <malloc.h>
+#include <console.h>
+#include <cells.h>
+
+/* the character part of a screen cell */
+#define CELL_CHAR(cell) ((char)((cell)&0xFF))
+
+/* CRTC registers holding the offset of the first visible cell */
+#define CRTC_START_MSB_IDX 12
+#define CRTC_START_LSB_IDX 13
+
+/* number of CRTC registers whose contents are cached */
+#define CRTC_NUM_REGS 25
+
+/* number of whole rows in the 32k VGA text aperture */
+#define VGA_APERTURE_ROWS ((32*1024/2)/CONSOLE_WIDTH)
+
+/* number of aperture rows owned by each virtual console */
+#define VCONS_ROWS (VGA_APERTURE_ROWS/NUM_CONSOLES)
+
+/* size in bytes of one row of cells */
+#define ROW_BYTES (2*CONSOLE_WIDTH)
+
+/* default number of rows remembered after they scroll off */
+#define SCROLLBACK_ROWS 256
+
+/* The state of one virtual console. */
+typedef struct vcons {
+  /* the position and state of the cursor */
+  unsigned int row_pos;
+  unsigned int col_pos;
+  unsigned int is_hidden;
+  /* the color of the console window */
+  unsigned int color;
+  /*
+   * The off-screen copy of the display, kept as a ring of rows.
+   * Screen row 0 lives in ring row top.
+   */
+  uint16_t shadow[CONSOLE_HEIGHT*CONSOLE_WIDTH];
+  unsigned int top;
+  /*
+   * The first VGA row of this console's slice of the aperture, and
+   * the row of the slice at which screen row 0 is drawn.
+   */
+  unsigned int vga_base;
+  unsigned int vga_origin;
+  /*
+   * The columns [dirty_lo,dirty_hi) of each ring row have changed
+   * since the last flush. A row is clean when dirty_lo >= dirty_hi.
+   */
+  unsigned char dirty_lo[CONSOLE_HEIGHT];
+  unsigned char dirty_hi[CONSOLE_HEIGHT];
+  /*
+   * The scrollback ring: room for history_depth rows, of which the
+   * history_count most recent are valid. history_next is the ring row
+   * the next scrolled off row is saved to.
+   */
+  uint16_t *history;
+  unsigned int history_depth;
+  unsigned int history_count;
+  unsigned int history_next;
+  /* how many rows back into the history the screen shows; 0 when live */
+  unsigned int view_offset;
+} vcons_t;
+
+/* The virtual consoles. */
+static vcons_t consoles[NUM_CONSOLES];
+
+/* The console the p1kern.h calls draw into. */
+static vcons_t *cons;
+
+/* The console on the screen. */
+static vcons_t *shown;
 
 /*
- * The position and state of the cursor are
- * maintained by these variables variable.
+ * The last value written to each CRTC register and the last
+ * register selected through CRTC_IDX_REG; -1 when unknown.
+ */
+static int crtc_regs[CRTC_NUM_REGS];
+static int crtc_idx;
+
+/* Set while a caller batches its updates for one console_flush(). */
+static unsigned int is_deferred;
+
+/** @brief maps a screen row to its row in the shadow ring
+ *
+ *  @param c The console
+ *  @param row The screen row
+ *  @return unsigned the ring row
  */
-static unsigned int row_pos;
-static unsigned int col_pos;
-static unsigned int is_hidden;
+static unsigned int ring_row(vcons_t *c,unsigned int row)
+{
+  row+=c->top;
+  if(row>=CONSOLE_HEIGHT)
+    row-=CONSOLE_HEIGHT;
+  return row;
+}
 
+/** @brief returns the shadow cells of a screen row
+ *
+ *  @param c The console
+ *  @param row The screen row
+ *  @return uint16_t* the first cell of the row
+ */
+static uint16_t *shadow_row(vcons_t *c,unsigned int row)
+{
+  return c->shadow+ring_row(c,row)*CONSOLE_WIDTH;
+}
 
-/* Maintains the color of the console window. */
-static unsigned int console_color;
+/** @brief returns a row of a console's window in video memory
+ *
+ *  @param c The console
+ *  @param row The screen row
+ *  @return uint16_t* the first cell of the row in video memory
+ */
+static uint16_t *vga_row(vcons_t *c,unsigned int row)
+{
+  return (uint16_t *)CONSOLE_MEM_BASE +
+         (c->vga_base+c->vga_origin+row)*CONSOLE_WIDTH;
+}
+
+/** @brief returns a row of the scrollback history
+ *
+ *  @param c The console
+ *  @param line The history row, 0 being the oldest one kept
+ *  @return uint16_t* the first cell of the row
+ */
+static uint16_t *history_row(vcons_t *c,unsigned int line)
+{
+  line+=c->history_next+c->history_depth-c->history_count;
+  if(line>=c->history_depth)
+    line-=c->history_depth;
+  return c->history+line*CONSOLE_WIDTH;
+}
+
+/** @brief grows the dirty span of a row to cover [lo,hi)
+ *
+ *  @param c The console
+ *  @param row The screen row that was changed
+ *  @param lo The first changed column
+ *  @param hi One past the last changed column
+ *  @return Void.
+ */
+static void mark_dirty(vcons_t *c,unsigned int row,unsigned int lo,
+                       unsigned int hi)
+{
+  row=ring_row(c,row);
+  if(c->dirty_lo[row]>=c->dirty_hi[row]) {
+    c->dirty_lo[row]=lo;
+    c->dirty_hi[row]=hi;
+    return;
+  }
+  if(lo<c->dirty_lo[row])
+    c->dirty_lo[row]=lo;
+  if(hi>c->dirty_hi[row])
+    c->dirty_hi[row]=hi;
+}
+
+/** @brief marks the whole screen of a console as changed
+ *
+ *  @param c The console
+ *  @return Void.
+ */
+static void mark_all_dirty(vcons_t *c)
+{
+  int row;
+  for(row=0;row<CONSOLE_HEIGHT;row++) {
+    c->dirty_lo[row]=0;
+    c->dirty_hi[row]=CONSOLE_WIDTH;
+  }
+}
+
+/** @brief scrolls the screen of the current console up by one row
+ *
+ *  The top row is saved to the history and recycled as the new,
+ *  blank bottom row, and the display window moves one row down the
+ *  console's slice of the aperture, so nothing that is already on the
+ *  screen has to be copied. If the window would run off the slice it
+ *  restarts at the top and the whole screen is redrawn there by the
+ *  next flush.
+ *
+ *  @return Void.
+ */
+static void scroll()
+{
+  uint16_t *row=cons->shadow+cons->top*CONSOLE_WIDTH;
+  if(cons->history_depth) {
+    cellcpy(cons->history+cons->history_next*CONSOLE_WIDTH,row,CONSOLE_WIDTH);
+    if((++cons->history_next)==cons->history_depth)
+      cons->history_next=0;
+    if(cons->history_count<cons->history_depth)
+      cons->history_count++;
+    /* keep a history view on the rows it was showing */
+    if(cons->view_offset && cons->view_offset<cons->history_count)
+      cons->view_offset++;
+  }
+  cellset(row,CELL('\0',cons->color),CONSOLE_WIDTH);
+  if((++cons->top)==CONSOLE_HEIGHT)
+    cons->top=0;
+  if((++cons->vga_origin)+CONSOLE_HEIGHT>VCONS_ROWS) {
+    cons->vga_origin=0;
+    mark_all_dirty(cons);
+  }
+  else
+    mark_dirty(cons,CONSOLE_HEIGHT-1,0,CONSOLE_WIDTH);
+}
+
+/** @brief writes a CRTC register unless it already holds the value
+ *
+ *  The index register is only rewritten when a different
+ *  register is selected.
+ *
+ *  @param idx The CRTC register
+ *  @param val The value to store in it
+ *  @return Void.
+ */
+static void crtc_write(int idx,int val)
+{
+  if(crtc_regs[idx]==val)
+    return;
+  if(crtc_idx!=idx) {
+    outb(CRTC_IDX_REG,idx);
+    crtc_idx=idx;
+  }
+  outb(CRTC_DATA_REG,val);
+  crtc_regs[idx]=val;
+}
+
+/** @brief programs the CRTC with the shown console's window and cursor
+ *
+ *  A hidden cursor, or any cursor while the history is being
+ *  viewed, is parked on the row below the window.
+ *
+ *  @return Void.
+ */
+static void program_crtc()
+{
+  int origin=shown->vga_base+shown->vga_origin;
+  int start=origin*CONSOLE_WIDTH;
+  int cursor_pos;
+  if(shown->is_hidden || shown->view_offset)
+    cursor_pos=(origin+CONSOLE_HEIGHT)*CONSOLE_WIDTH + CONSOLE_WIDTH;
+  else
+    cursor_pos=(origin+shown->row_pos)*CONSOLE_WIDTH + shown->col_pos;
+  crtc_write(CRTC_START_MSB_IDX,(start>>8));
+  crtc_write(CRTC_START_LSB_IDX,(start & 0x00FF));
+  crtc_write(CRTC_CURSOR_MSB_IDX,(cursor_pos>>8));
+  crtc_write(CRTC_CURSOR_LSB_IDX,(cursor_pos & 0x00FF));
+}
+
+/** @brief pushes pending changes to the screen unless deferred
+ *
+ *  @return Void.
+ */
+static void sync()
+{
+  if(!is_deferred)
+    console_flush();
+}
 
 void console_init()
 {
-  is_hidden=0;
-  row_pos=0;
-  col_pos=0;
-  set_term_color(FGND_WHITE | BGND_BLACK);
-  clear_console();
-  set_cursor(0,0);
+  int i;
+  for(i=0;i<CRTC_NUM_REGS;i++)
+    crtc_regs[i]=-1;
+  crtc_idx=-1;
+  is_deferred=0;
+  shown=&consoles[0];
+  for(i=NUM_CONSOLES-1;i>=0;i--) {
+    cons=&consoles[i];
+    cons->is_hidden=0;
+    cons->view_offset=0;
+    cons->row_pos=0;
+    cons->col_pos=0;
+    cons->top=0;
+    cons->vga_base=i*VCONS_ROWS;
+    cons->vga_origin=0;
+    console_scrollback(SCROLLBACK_ROWS);
+    set_term_color(FGND_WHITE | BGND_BLACK);
+    clear_console();
+    set_cursor(0,0);
+  }
 }
 
-int putbyte( char ch )
+/** @brief copies the dirty span of every row of a console to its slice
+ *
+ *  @param c The console
+ *  @return Void.
+ */
+static void draw_dirty(vcons_t *c)
+{
+  unsigned int row,ring,lo,hi;
+  for(row=0;row<CONSOLE_HEIGHT;row++) {
+    ring=ring_row(c,row);
+    lo=c->dirty_lo[ring];
+    hi=c->dirty_hi[ring];
+    if(lo>=hi)
+      continue;
+    /* clear the span first so a concurrent update is never lost */
+    c->dirty_lo[ring]=CONSOLE_WIDTH;
+    c->dirty_hi[ring]=0;
+    cellcpy(vga_row(c,row)+lo,c->shadow+ring*CONSOLE_WIDTH+lo,hi-lo);
+  }
+}
+
+/** @brief draws the history view of the shown console into its window
+ *
+ *  The rows shown are the last view_offset history rows
+ *  followed by the top of the live screen.
+ *
+ *  @return Void.
+ */
+static void draw_view()
+{
+  unsigned int row,line;
+  uint16_t *src;
+  for(row=0;row<CONSOLE_HEIGHT;row++) {
+    line=shown->history_count-shown->view_offset+row;
+    if(line<shown->history_count)
+      src=history_row(shown,line);
+    else
+      src=shadow_row(shown,line-shown->history_count);
+    cellcpy(vga_row(shown,row),src,CONSOLE_WIDTH);
+  }
+  program_crtc();
+}
+
+void console_defer()
+{
+  is_deferred=1;
+}
+
+void console_flush()
+{
+  int i;
+  /* a live screen stays off its window while its history is shown */
+  for(i=0;i<NUM_CONSOLES;i++)
+    if(!consoles[i].view_offset)
+      draw_dirty(&consoles[i]);
+  if(!shown->view_offset)
+    program_crtc();
+  is_deferred=0;
+}
+
+int console_select(int n)
+{
+  int prev=cons-consoles;
+  if((unsigned)n>=NUM_CONSOLES)
+    return -1;
+  cons=&consoles[n];
+  return prev;
+}
+
+int console_switch(int n)
+{
+  if((unsigned)n>=NUM_CONSOLES)
+    return -1;
+  if(shown==&consoles[n])
+    return 0;
+  console_view_live();
+  shown=&consoles[n];
+  /* the console is already drawn in its slice; just point the CRTC at it */
+  sync();
+  program_crtc();
+  return 0;
+}
+
+int console_scrollback(int rows)
+{
+  uint16_t *buf=NULL;
+  if(rows<0)
+    return -1;
+  if(rows) {
+    buf=smalloc(rows*ROW_BYTES);
+    if(!buf)
+      return -1;
+  }
+  if(cons==shown)
+    console_view_live();
+  if(cons->history)
+    sfree(cons->history,cons->history_depth*ROW_BYTES);
+  cons->history=buf;
+  cons->history_depth=rows;
+  cons->history_count=0;
+  cons->history_next=0;
+  return 0;
+}
+
+void console_view_scroll(int rows)
+{
+  int offset=shown->view_offset+rows;
+  if(offset<0)
+    offset=0;
+  if(offset>shown->history_count)
+    offset=shown->history_count;
+  if(offset==shown->view_offset)
+    return;
+  shown->view_offset=offset;
+  if(shown->view_offset) {
+    draw_view();
+    return;
+  }
+  /* back to live: the window holds history rows, redraw all of it */
+  mark_all_dirty(shown);
+  sync();
+}
+
+void console_view_live()
+{
+  console_view_scroll(-shown->view_offset);
+}
+
+/** @brief moves the output position to the start of the next line
+ *
+ *  Scrolls when the bottom of the screen is passed.
+ *
+ *  @return Void.
+ */
+static void newline()
+{
+  cons->col_pos=0;
+  if((++cons->row_pos)==CONSOLE_HEIGHT) {
+    cons->row_pos=CONSOLE_HEIGHT-1;
+    scroll();
+  }
+}
+
+/** @brief applies a '\b', '\r' or '\n' to the output position
+ *
+ *  Only the shadow is touched; the caller flushes and places
+ *  the hardware cursor.
+ *
+ *  @param ch The control character
+ *  @return Void.
+ */
+static void put_control(char ch)
 {
   if(ch=='\b') {
-    if(col_pos==0) {
-      if(row_pos==0)
-        return ch;
-      col_pos=CONSOLE_WIDTH-1;
-      row_pos--;
+    if(cons->col_pos==0) {
+      if(cons->row_pos==0)
+        return;
+      cons->col_pos=CONSOLE_WIDTH-1;
+      cons->row_pos--;
     }
     else
-      col_pos--;
-    draw_char(row_pos,col_pos,'\0',console_color);
-    set_cursor(row_pos,col_pos);
-    return ch;
+      cons->col_pos--;
+    shadow_row(cons,cons->row_pos)[cons->col_pos]=CELL('\0',cons->color);
+    mark_dirty(cons,cons->row_pos,cons->col_pos,cons->col_pos+1);
+    return;
   }
   if(ch=='\r') {
-    col_pos=0;
-    set_cursor(row_pos,col_pos);
-    return ch;
-  }
-  if(ch!='\n') {
-    *(char *)(CONSOLE_MEM_BASE + 2*(row_pos*CONSOLE_WIDTH+col_pos))=ch;
-    *(char *)(CONSOLE_MEM_BASE + 2*(row_pos*CONSOLE_WIDTH+col_pos)+1)=console_color;
-  }
-  else
-    col_pos=CONSOLE_WIDTH-1;
-  if((++col_pos)==CONSOLE_WIDTH) {
-    col_pos=0;
-    row_pos++;
+    cons->col_pos=0;
+    return;
   }
-  if(row_pos==CONSOLE_HEIGHT) {
-    row_pos=CONSOLE_HEIGHT-1;
-    memmove((void *)CONSOLE_MEM_BASE,(const void *)(CONSOLE_MEM_BASE+CONSOLE_WIDTH),2*CONSOLE_WIDTH*(CONSOLE_HEIGHT-1));
+  newline();
+}
+
+int putbyte( char ch )
+{
+  if(ch=='\b' || ch=='\r' || ch=='\n')
+    put_control(ch);
+  else {
+    shadow_row(cons,cons->row_pos)[cons->col_pos]=CELL(ch,cons->color);
+    mark_dirty(cons,cons->row_pos,cons->col_pos,cons->col_pos+1);
+    if((++cons->col_pos)==CONSOLE_WIDTH)
+      newline();
   }
-  set_cursor(row_pos,col_pos);
+  sync();
   return ch;
 }
 
 void putbytes( const char *s, int len )
 {
-  for(;len>0;len--) {
-    putbyte(*s);
-    s++;
+  const char *end=s+len;
+  uint16_t *row;
+  unsigned int start,col;
+  uint16_t blank;
+  if(len<=0)
+    return;
+  blank=CELL('\0',cons->color);
+  while(s<end) {
+    if(*s=='\b' || *s=='\r' || *s=='\n') {
+      put_control(*s++);
+      continue;
+    }
+    /* store the run of printable characters up to the end of the row */
+    row=shadow_row(cons,cons->row_pos);
+    start=col=cons->col_pos;
+    while(s<end && col<CONSOLE_WIDTH &&
+          *s!='\b' && *s!='\r' && *s!='\n')
+      row[col++]=blank | (unsigned char)*s++;
+    cons->col_pos=col;
+    mark_dirty(cons,cons->row_pos,start,col);
+    if(col==CONSOLE_WIDTH)
+      newline();
   }
+  sync();
 }
 
 int set_term_color( int color )
 {
   if((unsigned)color>(BLINK | BGND_BLACK | FGND_WHITE))
     return -1;
-  console_color=color;
+  cons->color=color;
   return 0;
 }
 
 void get_term_color( int *color )
 {
-  *color=console_color;
+  *color=cons->color;
 }
 
 int set_cursor( int row, int col )
 {
   if((unsigned)row>=CONSOLE_HEIGHT || (unsigned)col>=CONSOLE_WIDTH)
     return -1;
-  row_pos=row;
-  col_pos=col;
-  if(!is_hidden) {
-    int cursor_pos=row*CONSOLE_WIDTH + col;
-    outb(CRTC_IDX_REG,CRTC_CURSOR_MSB_IDX);
-    outb(CRTC_DATA_REG,(cursor_pos>>8));
-    outb(CRTC_IDX_REG,CRTC_CURSOR_LSB_IDX);
-    outb(CRTC_DATA_REG,(cursor_pos & 0x00FF));
-  }
+  cons->row_pos=row;
+  cons->col_pos=col;
+  sync();
   return 0;
 }
 
 void get_cursor( int *row, int *col )
 {
-  *row=row_pos;
-  *col=col_pos;
+  *row=cons->row_pos;
+  *col=cons->col_pos;
 }
 
 void hide_cursor()
 {
-  int cursor_pos=CONSOLE_HEIGHT*CONSOLE_WIDTH + CONSOLE_WIDTH;
-  outb(CRTC_IDX_REG,CRTC_CURSOR_MSB_IDX);
-  outb(CRTC_DATA_REG,(cursor_pos>>8));
-  outb(CRTC_IDX_REG,CRTC_CURSOR_LSB_IDX);
-  outb(CRTC_DATA_REG,(cursor_pos & 0x000F));
-  is_hidden=1;
+  cons->is_hidden=1;
+  sync();
 }
 
 void show_cursor()
 {
-  is_hidden=0;
-  set_cursor(row_pos,col_pos);
+  cons->is_hidden=0;
+  sync();
 }
 
 void clear_console()
 {
-  int row,col;
-  for(row=0;row<CONSOLE_HEIGHT;row++) {
-    for(col=0;col<CONSOLE_WIDTH;col++) {
-      *(char *)(CONSOLE_MEM_BASE + 2*(row*CONSOLE_WIDTH+col))='\0';
-      *(char *)(CONSOLE_MEM_BASE + 2*(row*CONSOLE_WIDTH+col)+1)=console_color;
-    }
-  }
+  cellset(cons->shadow,CELL('\0',cons->color),CONSOLE_HEIGHT*CONSOLE_WIDTH);
+  mark_all_dirty(cons);
   set_cursor(0,0);
 }
 
@@ -150,11 +600,47 @@ void draw_char( int row, int col, int ch, int color )
 {
   if((unsigned)row>=CONSOLE_HEIGHT || (unsigned)col>=CONSOLE_WIDTH || (unsigned)color>(BLINK | BGND_BLACK | FGND_WHITE))
     return;
-  *(char *)(CONSOLE_MEM_BASE + 2*(row*CONSOLE_WIDTH+col))=ch;
-  *(char *)(CONSOLE_MEM_BASE + 2*(row*CONSOLE_WIDTH+col)+1)=color;
+  shadow_row(cons,row)[col]=CELL(ch,color);
+  mark_dirty(cons,row,col,col+1);
+  sync();
+}
+
+/** @brief clips a span of cells to the row it starts in
+ *
+ *  @param row The row of the span
+ *  @param col The first column of the span
+ *  @param n The length of the span
+ *  @return int the number of cells of the span on the screen,
+ *          0 if it starts off the screen
+ */
+static int clip_span(int row,int col,int n)
+{
+  if((unsigned)row>=CONSOLE_HEIGHT || (unsigned)col>=CONSOLE_WIDTH || n<=0)
+    return 0;
+  if(n>CONSOLE_WIDTH-col)
+    n=CONSOLE_WIDTH-col;
+  return n;
+}
+
+void draw_cells(int row,int col,const uint16_t *cells,int n)
+{
+  if(!(n=clip_span(row,col,n)))
+    return;
+  cellcpy(shadow_row(cons,row)+col,cells,n);
+  mark_dirty(cons,row,col,col+n);
+  sync();
+}
+
+void fill_cells(int row,int col,uint16_t cell,int n)
+{
+  if(!(n=clip_span(row,col,n)))
+    return;
+  cellset(shadow_row(cons,row)+col,cell,n);
+  mark_dirty(cons,row,col,col+n);
+  sync();
 }
 
 char get_char( int row, int col )
 {
-  return *(char *)(CONSOLE_MEM_BASE + 2*(row*CONSOLE_WIDTH+col));
+  return CELL_CHAR(shadow_row(cons,row)[col]);
 }
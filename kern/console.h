@@ -6,4 +6,98 @@
  *  @author Sohil Habib (snhabib)
  */
 
+#include <stdint.h>
+
+/* number of virtual consoles */
+#define NUM_CONSOLES 2
+
+/* builds a screen cell out of a character and its color */
+#define CELL(ch,color) ((uint16_t)((((color)&0xFF)<<8) | ((ch)&0xFF)))
+
 void console_init();
+
+/** @brief starts batching console updates
+ *
+ *  Until the next console_flush() drawing only touches the
+ *  off-screen buffer, so a full repaint reaches the screen
+ *  in one pass.
+ *
+ *  @return Void.
+ */
+void console_defer();
+
+/** @brief copies every changed span to the screen
+ *
+ *  Also ends a batch started by console_defer().
+ *
+ *  @return Void.
+ */
+void console_flush();
+
+/** @brief sets how many rows are kept after they scroll off
+ *
+ *  The history is allocated from malloc_lmm and any rows already
+ *  remembered are dropped.
+ *
+ *  @param rows The number of rows to keep, 0 to keep none
+ *  @return int 0 on success, -1 if rows is negative or the
+ *          memory could not be allocated
+ */
+int console_scrollback(int rows);
+
+/** @brief moves the view through the scrollback history
+ *
+ *  Positive values move back to older rows, negative values
+ *  towards the live screen. While the view is in the history
+ *  output is still accepted but not shown.
+ *
+ *  @param rows The number of rows to move the view by
+ *  @return Void.
+ */
+void console_view_scroll(int rows);
+
+/** @brief returns the view to the live screen
+ *
+ *  @return Void.
+ */
+void console_view_live();
+
+/** @brief picks the virtual console the p1kern.h calls draw into
+ *
+ *  The console does not have to be the one on the screen.
+ *
+ *  @param n The console number, from 0 to NUM_CONSOLES-1
+ *  @return int the previously selected console, -1 if n is invalid
+ */
+int console_select(int n);
+
+/** @brief puts a virtual console on the screen
+ *
+ *  @param n The console number, from 0 to NUM_CONSOLES-1
+ *  @return int 0 on success, -1 if n is invalid
+ */
+int console_switch(int n);
+
+/** @brief draws a span of cells into one row
+ *
+ *  The span is cut off at the end of the row.
+ *
+ *  @param row The row to draw in
+ *  @param col The column of the first cell
+ *  @param cells The cells, each built with CELL()
+ *  @param n The number of cells
+ *  @return Void.
+ */
+void draw_cells(int row,int col,const uint16_t *cells,int n);
+
+/** @brief fills a span of one row with the same cell
+ *
+ *  The span is cut off at the end of the row.
+ *
+ *  @param row The row to draw in
+ *  @param col The column of the first cell
+ *  @param cell The cell, built with CELL()
+ *  @param n The number of cells
+ *  @return Void.
+ */
+void fill_cells(int row,int col,uint16_t cell,int n);
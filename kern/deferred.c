@@ -0,0 +1,73 @@
+/** @file deferred.c
+ *  @brief the file contains the deferred work queue
+ *
+ *  The queue is a ring like the keyboard buffer. Only the main loop
+ *  removes work, but a timer callback and a keyboard handler can both
+ *  add it, so adding is done with interrupts off.
+ *
+ *  @author Sohil Habib (snhabib)
+ *  @bug No known bugs.
+ */
+
+/* necessary includes */
+#include <stdint.h>
+#include <x86/asm.h>
+#include <x86/eflags.h>
+#include <deferred.h>
+
+/* turns a free running queue index into a slot */
+#define WORK_MASK (MAX_DEFERRED-1)
+
+/** @brief a queued piece of work */
+typedef struct work {
+  void (*fn)(void *);
+  void *arg;
+} work_t;
+
+/* the queued work */
+static work_t work_queue[MAX_DEFERRED];
+
+/* free running index of the next work to run; written only by run_deferred */
+static volatile unsigned int work_head;
+
+/* free running index of the next free slot */
+static volatile unsigned int work_tail;
+
+int defer_work(void (*fn)(void *),void *arg)
+{
+  uint32_t flags=get_eflags();
+  unsigned int i;
+  disable_interrupts();
+  for(i=work_head;i!=work_tail;i++)
+    if(work_queue[i & WORK_MASK].fn==fn && work_queue[i & WORK_MASK].arg==arg) {
+      set_eflags(flags);
+      return 0;
+    }
+  if(work_tail-work_head==MAX_DEFERRED) {
+    set_eflags(flags);
+    return -1;
+  }
+  work_queue[work_tail & WORK_MASK].fn=fn;
+  work_queue[work_tail & WORK_MASK].arg=arg;
+  work_tail++;
+  set_eflags(flags);
+  return 0;
+}
+
+int run_deferred()
+{
+  work_t w;
+  int n=0;
+  while(work_head!=work_tail) {
+    w=work_queue[work_head & WORK_MASK];
+    work_head++;
+    w.fn(w.arg);
+    n++;
+  }
+  return n;
+}
+
+int deferred_pending()
+{
+  return work_head!=work_tail;
+}
@@ -0,0 +1,37 @@
+/** @file deferred.h
+ *  @brief function definition for the deferred work queue
+ *
+ *  Interrupt handlers queue work here instead of doing it, and the
+ *  main loop runs it the next time it waits for input, so drawing
+ *  and other slow work never happen in interrupt context.
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+/* number of work items that can be queued at once */
+#define MAX_DEFERRED 16
+
+/** @brief queues a function to be run from the main loop
+ *
+ *  Safe to call from interrupt handlers. Work already queued with
+ *  the same function and argument is not queued twice.
+ *
+ *  @param fn The function to run
+ *  @param arg The argument to run fn with
+ *  @return int 0 on success, -1 if the queue is full
+ */
+int defer_work(void (*fn)(void *),void *arg);
+
+/** @brief runs all the queued work
+ *
+ *  Must not be called from interrupt context.
+ *
+ *  @return int the number of work items run
+ */
+int run_deferred();
+
+/** @brief returns whether any work is queued
+ *
+ *  @return int nonzero if work is queued
+ */
+int deferred_pending();
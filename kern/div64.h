@@ -0,0 +1,21 @@
+/** @file div64.h
+ *  @brief function definition for 64 bit division
+ *
+ *  The kernel is not linked against libgcc, so a 64 bit division
+ *  written in C has nothing to call.
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+#include <stdint.h>
+
+/** @brief div64_32 divides a 64 bit value with a single divl
+ *
+ *  The quotient has to fit in 32 bits, that is n>>32 must be less
+ *  than d, or the cpu raises a divide error.
+ *
+ *  @param n The dividend
+ *  @param d The divisor
+ *  @return uint32_t the quotient n/d
+ */
+uint32_t div64_32(uint64_t n,uint32_t d);
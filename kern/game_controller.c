@@ -13,6 +13,21 @@
 
 #include <p1kern.h>
 #include <video_defines.h>
+#include <console.h>
+#include <kbd_handler.h>
+#include <timer_handler.h>
+#include <timer_wheel.h>
+#include <deferred.h>
+#include <clock.h>
+#include <div64.h>
+#include <board.h>
+#include <hint.h>
+#include <autoplay.h>
+#include <mcts.h>
+#include <history.h>
+#include <latency.h>
+#include <x86/asm.h>
+#include <x86/eflags.h>
 
 /* libc includes. */
 #include <stdio.h>
@@ -23,10 +38,10 @@
 #include <string.h>
 
 /* max number of rows in game mesh */
-#define NUM_ROW 10
+#define NUM_ROW BOARD_ROWS
 
 /* max number of columns in game mesh */
-#define NUM_COL 15
+#define NUM_COL BOARD_COLS
 
 /* screen max x coordinate */
 #define SCREEN_X 80
@@ -34,6 +49,24 @@
 /* screen max y coordinate */
 #define SCREEN_Y 25
 
+/* clock redraws per second */
+#define CLOCK_HZ 10
+
+/* nanoseconds per tenth of a second shown on the clock */
+#define NS_PER_TENTH 100000000
+
+/* keys the autoplayer types per second */
+#define AUTOPLAY_KEYS_HZ 20
+
+/* milliseconds the autoplayer may search for each move */
+#define AUTOPLAY_BUDGET_MS 200
+
+/* milliseconds the solver may search when asked */
+#define SOLVER_BUDGET_MS 1000
+
+/* bytes of undo history, a few hundred moves */
+#define HISTORY_BYTES 4096
+
 /* buffer size definitions */
 #define BIG_BUFF 32
 #define SMALL_BUFF 8
@@ -49,20 +82,34 @@ void tick(unsigned int numTicks);
 void game_init();
 void display_prompts();
 void set_block(unsigned int r,unsigned int c,int color);
+void set_blocks(unsigned int r,unsigned int c,int n,int color);
 void set_game_cursor(int r,int c,char ch);
 void render_mesh();
-void deleteblocks(int row, int col,int init);
+void render_columns(unsigned int cols);
+void update_hint();
+int autoplay_key();
+void ask_solver();
+void show_combo();
+int play_move(const history_move_t *m);
+void undo_move(const history_move_t *m);
 void display_string(char *str,int row,int col,int color);
-void compact();
 void home_screen();
 void complete_screen();
 void home_prompts();
 void instruction_screen();
 void game_run();
 int game_complete();
+void clock_start();
+void clock_stop();
 
-/* the array which maintains game mesh state */
-unsigned int color_arr[NUM_ROW][NUM_COL];
+/* the board which maintains game mesh state */
+board_t board;
+/* the regions of the board, kept up to date after every move */
+board_regions_t regions;
+/* the screen color of each color id on the board */
+static const unsigned int block_colors[BOARD_COLORS]={BLUE,RED,GREEN};
+/* the color each block was last drawn in */
+unsigned int drawn_arr[NUM_ROW][NUM_COL];
 /* the game score */
 unsigned int score;
 /* the row position of game cursor */
@@ -71,10 +118,14 @@ unsigned int row_pos;
 unsigned int col_pos;
 /* the seed to generate the random number for a game session */
 unsigned int game_seed;
-/* the color of the block last cleared */
+/* the color id of the region last cleared */
 int last_color;
-/* in game time */
-int game_time;
+/* in game time in nanoseconds, up to the last clock_stop */
+uint64_t game_time;
+/* clock_ns() at the last clock_start */
+uint64_t resume_ns;
+/* nonzero while the game clock runs */
+int is_timing;
 /* the high score!! */
 int high_score;
 /* the state of the game to effectively handle each case */
@@ -85,6 +136,24 @@ int selected_area_size;
 int combo_multiplier;
 /* the color of the current combo multiplier */
 int combo_color;
+/* the combo multiplier on screen */
+char combo[SMALL_BUFF];
+/* nonzero while hints are shown */
+int hint_on;
+/* the region marked as the hint, as one mask per column */
+uint16_t hint_region[BOARD_COLS];
+/* nonzero while the autoplayer plays the game */
+int autoplay_on;
+/* the move the autoplayer is moving the cursor to */
+board_move_t autoplay_target;
+/* nonzero while autoplay_target is still to be played */
+int autoplay_aimed;
+/* the timer redrawing the clock, -1 when stopped */
+int clock_timer=-1;
+/* the clock value on screen, in tenths of a second, -1 if unknown */
+int drawn_time=-1;
+/* the score on screen, -1 if unknown */
+int drawn_score=-1;
 
 /** @brief game_run is the entry point of the game
  *
@@ -96,6 +165,7 @@ int combo_color;
 void game_run()
 {
   hide_cursor();
+  history_budget(HISTORY_BYTES);
   curr_state=exit;
   home_screen();
   do {
@@ -134,8 +204,10 @@ void complete_screen()
   display_string("'r' to restart",NUM_ROW-1,NUM_COL*2,BLACK);
   display_string("'e' to exit",NUM_ROW,NUM_COL*2,BLACK);
   char c;
+  // the clock is frozen, so the timer can stop until a key is hit
+  timer_tickless(1);
   while(1) {
-    c=readchar();
+    c=readchar_wait();
     if(c=='r') {
       curr_state=resume;
       return;
@@ -147,21 +219,108 @@ void complete_screen()
   }
 }
 
+/** @brief returns the screen color of a block
+ *
+ *  @param r The row of the block
+ *  @param c The column of the block
+ *  @return unsigned the color to draw the block in, BLACK if
+ *          there is no block
+ */
+static unsigned int block_attr(int r,int c)
+{
+  int color=board_get(&board,r,c);
+  return color==BOARD_EMPTY ? BLACK : block_colors[color];
+}
+
 /** @brief render_mesh renders the game mesh.
  *
  *  This function is responsible for siplaying the
  *  color matrix on the screen after each user action.
+ *  Repaints every block, for when the screen has been
+ *  cleared; each run of blocks of one color in a row is
+ *  drawn as a single span.
  *
  *  @return Void.
  */
 void render_mesh()
 {
-  int i,j;
+  int i,j,k;
+  console_defer();
   for(i=0;i<NUM_ROW;i++) {
-    for(j=0;j<NUM_COL;j++) {
-      set_block(i,j,color_arr[i][j]);
+    for(j=0;j<NUM_COL;j=k) {
+      for(k=j+1;k<NUM_COL && board_get(&board,i,k)==board_get(&board,i,j);k++);
+      set_blocks(i,j,k-j,block_attr(i,j));
     }
   }
+  console_flush();
+}
+
+/** @brief render_columns renders the blocks of the given
+ *         columns that have changed since they were drawn.
+ *
+ *  Used after a move, when only the columns it touched can
+ *  have changed. Each block is compared with the color it
+ *  was last drawn in, and each run of changed blocks that
+ *  now have one color is drawn as a single span.
+ *
+ *  @param cols A mask of the columns to check, bit c standing
+ *         for column c
+ *  @return Void.
+ */
+void render_columns(unsigned int cols)
+{
+  int i,j,k;
+  unsigned int color;
+  console_defer();
+  for(i=0;i<NUM_ROW;i++) {
+    for(j=0;j<NUM_COL;j=k) {
+      k=j+1;
+      color=block_attr(i,j);
+      if(!(cols & (1<<j)) || drawn_arr[i][j]==color)
+        continue;
+      while(k<NUM_COL && (cols & (1<<k)) && block_attr(i,k)==color &&
+            drawn_arr[i][k]!=color)
+        k++;
+      set_blocks(i,j,k-j,color);
+    }
+  }
+  console_flush();
+}
+
+/** @brief update_hint moves the hint to the best move.
+ *
+ *  The blocks of the old hint are redrawn plain, and if hints
+ *  are on, every block of the region that would score the most
+ *  is marked at its corners. Called whenever the board or the
+ *  combo changes, and after the mesh is repainted.
+ *
+ *  @return Void.
+ */
+void update_hint()
+{
+  board_move_t best;
+  unsigned int bits;
+  int r,c;
+  console_defer();
+  for(c=0;c<NUM_COL;c++)
+    for(bits=hint_region[c];bits;bits&=bits-1) {
+      r=BOARD_ROW(__builtin_ctz(bits));
+      set_block(r,c,block_attr(r,c));
+    }
+  memset(hint_region,0,sizeof(hint_region));
+  if(hint_on && hint_best(&regions,last_color,combo_multiplier,&best)) {
+    board_region_mask(&regions,best.row,best.col,hint_region);
+    for(c=0;c<NUM_COL;c++)
+      for(bits=hint_region[c];bits;bits&=bits-1) {
+        r=BOARD_ROW(__builtin_ctz(bits));
+        set_term_color(block_attr(r,c));
+        set_cursor(r*2+2,c*4+2);
+        putbytes("+",1);
+        set_cursor(r*2+3,c*4+5);
+        putbytes("+",1);
+      }
+  }
+  console_flush();
 }
 
 /** @brief instruction_screen renders the intruction
@@ -181,6 +340,7 @@ void instruction_screen()
   set_term_color(BLACK);
   y_pos=(SCREEN_Y/2)-6;
   x_pos=SCREEN_X/2;
+  console_defer();
   clear_console();
   snprintf(prompt,BIG_BUFF,"!!Instructions!!");
   display_string(prompt,y_pos,x_pos-10,BLACK);
@@ -210,6 +370,12 @@ void instruction_screen()
   display_string(prompt,y_pos+11,x_pos-30,BLACK);
   snprintf(prompt,BIG_BUFF,"'e' to EXIT");
   display_string(prompt,y_pos+12,x_pos-30,BLACK);
+  snprintf(prompt,BIG_BUFF,"'h' to show or hide HINTS");
+  display_string(prompt,y_pos+13,x_pos-30,BLACK);
+  snprintf(prompt,BIG_BUFF,"'m' to ask the SOLVER");
+  display_string(prompt,y_pos+14,x_pos-30,BLACK);
+  snprintf(prompt,BIG_BUFF,"'u' to UNDO, 'n' to REDO");
+  display_string(prompt,y_pos+15,x_pos-30,BLACK);
   if(game_time) {
     snprintf(prompt,BIG_BUFF,"Current time: ");
     display_string(prompt,SCREEN_Y-2,1,BLACK);
@@ -222,6 +388,7 @@ void instruction_screen()
   snprintf(prompt,BIG_BUFF,"Sohil Habib 2014");
   x_pos=strlen(prompt);
   display_string(prompt,SCREEN_Y-1,SCREEN_X-(x_pos+2),BLACK);
+  console_flush();
 }
 
 /** @brief home_screen renders the game home screen logic.
@@ -238,17 +405,19 @@ void home_screen()
   home_prompts();
   score=0;
   game_time=0;
+  timer_tickless(1);
   while(1)
   {
-    c=readchar();
+    c=readchar_wait();
     if(c=='x') {
       instruction_screen();
-      while(readchar()!='y');
+      while(readchar_wait()!='y');
       clear_console();
       home_prompts();
       continue;
     }
-    if(c=='s') {
+    if(c=='s' || c=='a') {
+      autoplay_on=(c=='a');
       curr_state=resume;
       return;
     }
@@ -267,6 +436,7 @@ void home_prompts()
 {
   char prompt[BIG_BUFF];
   set_term_color(BLACK);
+  console_defer();
   clear_console();
   snprintf(prompt,BIG_BUFF,"!!SAME GAME!!");
   display_string(prompt,SCREEN_Y/2,SCREEN_X/2-10,BLACK);
@@ -274,7 +444,85 @@ void home_prompts()
   display_string(prompt,SCREEN_Y/2+1,SCREEN_X/2-10,BLACK);
   snprintf(prompt,BIG_BUFF,"'s' to Start");
   display_string(prompt,SCREEN_Y/2+3,SCREEN_X/2-10,BLACK);
+  snprintf(prompt,BIG_BUFF,"'a' to watch Autoplay");
+  display_string(prompt,SCREEN_Y/2+4,SCREEN_X/2-10,BLACK);
   display_prompts();
+  console_flush();
+}
+
+/** @brief show_combo draws the combo multiplier.
+ *
+ *  Blanks the multiplier on screen and draws the current
+ *  one, in the color of the region last cleared.
+ *
+ *  @return Void.
+ */
+void show_combo()
+{
+  char *temp=combo;
+  while((*temp)!='\0') {
+    *temp=' ';temp++;
+  }
+  display_string(combo,(SCREEN_Y/2)+1,SCREEN_X-6,BLACK);
+  combo[0]='\0';
+  if(last_color==-1)
+    return;
+  combo_color=block_colors[last_color];
+  snprintf(combo,SMALL_BUFF,"%dX",combo_multiplier);
+  display_string(combo,(SCREEN_Y/2)+1,SCREEN_X-6,combo_color);
+}
+
+/** @brief play_move removes a region and scores it.
+ *
+ *  The combo multiplier goes up when the region has the color
+ *  of the one cleared before, and restarts otherwise; the
+ *  region scores its size times the multiplier.
+ *
+ *  @param m The move, with the region still on the board
+ *  @return int 1 if the move completed the game, 0 otherwise
+ */
+int play_move(const history_move_t *m)
+{
+  unsigned int cols=board_remove(&board,m->region);
+  board_relabel(&board,&regions,cols);
+  if(last_color==m->color)
+    combo_multiplier++;
+  else
+    combo_multiplier=1;
+  last_color=m->color;
+  selected_area_size=board_region_count(m->region);
+  score+=selected_area_size*combo_multiplier;
+  selected_area_size=0;
+  show_combo();
+  render_columns(cols);
+  update_hint();
+  if(!game_complete()) {
+    set_game_cursor(row_pos,col_pos,'|');
+    return 0;
+  }
+  set_game_cursor(row_pos,col_pos,'\0');
+  return 1;
+}
+
+/** @brief undo_move puts back the region a move removed.
+ *
+ *  The score loses what the move earned, and the combo goes
+ *  back to what it was before the move.
+ *
+ *  @param m The move, as recorded before it was played
+ *  @return Void.
+ */
+void undo_move(const history_move_t *m)
+{
+  unsigned int cols=board_restore(&board,m->region,m->color,m->kept);
+  board_relabel(&board,&regions,cols);
+  score-=board_region_count(m->region)*combo_multiplier;
+  last_color=m->last_color;
+  combo_multiplier=m->combo_multiplier;
+  show_combo();
+  render_columns(cols);
+  update_hint();
+  set_game_cursor(row_pos,col_pos,'|');
 }
 
 /** @brief game_start starts the game logic for a session
@@ -290,9 +538,10 @@ void home_prompts()
  */
 void game_start()
 {
-  char c;char combo[SMALL_BUFF]="";
+  char c;
+  history_move_t m;
   while(1){
-    c=readchar();
+    c=autoplay_on ? autoplay_key() : readchar_wait();
     if(c=='w') {
       if(row_pos-1==-1)
         continue;
@@ -322,48 +571,34 @@ void game_start()
       set_game_cursor(row_pos,col_pos,'|');
     }
     if(c==' ') {
-      int curr_color=color_arr[row_pos][col_pos];
-      if(curr_color==BLACK)
+      if(board_region_size(&regions,row_pos,col_pos)<2)
         continue;
-      deleteblocks(row_pos,col_pos,0);
-      if(selected_area_size) {
-        compact();
-        selected_area_size++;
-        if(last_color==curr_color) {
-          combo_color=curr_color;
-          combo_multiplier++;
-        }
-        else {
-          last_color=curr_color;
-          char *temp=combo;
-          while((*temp)!='\0') {
-            *temp=' ';temp++;
-          }
-          display_string(combo,(SCREEN_Y/2)+1,SCREEN_X-6,BLACK);
-          combo_color=curr_color;
-          combo_multiplier=1;
-        }
-        score+=selected_area_size*combo_multiplier;
-        snprintf(combo,SMALL_BUFF,"%dX",combo_multiplier);
-        display_string(combo,(SCREEN_Y/2)+1,SCREEN_X-6,combo_color);
-        selected_area_size=0;
-        render_mesh();
-        if(!game_complete())
-          set_game_cursor(row_pos,col_pos,'|');
-        else {
-          set_game_cursor(row_pos,col_pos,'\0');
-          break;
-        }
-      }
+      board_region_mask(&regions,row_pos,col_pos,m.region);
+      m.color=board_get(&board,row_pos,col_pos);
+      m.kept=board_kept(&board,m.region);
+      m.last_color=last_color;
+      m.combo_multiplier=combo_multiplier;
+      history_push(&m);
+      if(play_move(&m))
+        break;
     }
+    if(c=='u' && !history_undo(&m))
+      undo_move(&m);
+    if(c=='n' && !history_redo(&m) && play_move(&m))
+      break;
     if(c=='x') {
-      instruction_screen();
       curr_state=pause;
-      while(readchar()!='y');
+      clock_stop();
+      instruction_screen();
+      timer_tickless(1);
+      while(readchar_wait()!='y');
+      timer_tickless(0);
+      clock_start();
       set_term_color(BLACK);
       clear_console();
       curr_state=resume;
       render_mesh();
+      update_hint();
       display_prompts();
       set_game_cursor(row_pos,col_pos,'|');
       display_string(combo,(SCREEN_Y/2)+1,SCREEN_X-6,combo_color);
@@ -373,22 +608,99 @@ void game_start()
       curr_state=pause;
       set_game_cursor(row_pos,col_pos,'\0');
       display_string("PAUSED, press 'r' to RESUME",0,(SCREEN_X/2)-5,RED);
-      while(readchar()!='r');
+      clock_stop();
+      timer_tickless(1);
+      while(readchar_wait()!='r');
+      timer_tickless(0);
+      clock_start();
       curr_state=resume;
       set_term_color(BLACK);
       clear_console();
       render_mesh();
+      update_hint();
       display_prompts();
       set_game_cursor(row_pos,col_pos,'|');
       display_string(combo,(SCREEN_Y/2)+1,SCREEN_X-6,combo_color);
       continue;
     }
+    if(c=='m')
+      ask_solver();
+    if(c=='h') {
+      hint_on=!hint_on;
+      update_hint();
+      set_game_cursor(row_pos,col_pos,'|');
+    }
     if(c=='e')
     {
       curr_state=exit;
       return;
     }
+    // every update drawn for the key has been flushed by now
+    latency_render_done();
+  }
+}
+
+/** @brief autoplay_key returns the next key for game_start
+ *         while the autoplayer plays.
+ *
+ *  The autoplayer types a key every so often, walking the
+ *  cursor to the move it picked and then pressing space, so
+ *  its moves are played and drawn like the user's. A key the
+ *  user types in the meantime is passed on instead, and the
+ *  move is picked again afterwards.
+ *
+ *  @return int the key, -1 if there is none
+ */
+int autoplay_key()
+{
+  int c=readchar_timeout(timer_get_rate()/AUTOPLAY_KEYS_HZ);
+  if(c!=-1) {
+    autoplay_aimed=0;
+    return c;
+  }
+  if(!autoplay_aimed) {
+    if(!autoplay_search(&board,&regions,last_color,combo_multiplier,
+                        timer_get_rate()*AUTOPLAY_BUDGET_MS/1000,
+                        &autoplay_target))
+      return -1;
+    autoplay_aimed=1;
   }
+  if(row_pos>autoplay_target.row)
+    return 'w';
+  if(row_pos<autoplay_target.row)
+    return 's';
+  if(col_pos>autoplay_target.col)
+    return 'a';
+  if(col_pos<autoplay_target.col)
+    return 'd';
+  autoplay_aimed=0;
+  return ' ';
+}
+
+/** @brief ask_solver runs the solver on the board.
+ *
+ *  The cursor is moved to the move the solver recommends,
+ *  and the final score it expects from there is shown
+ *  under the multiplier.
+ *
+ *  @return Void.
+ */
+void ask_solver()
+{
+  char buf[BIG_BUFF];
+  mcts_result_t res;
+  display_string("THINKING...   ",(SCREEN_Y/2)+3,SCREEN_X-16,BLACK);
+  if(mcts_search(&board,&regions,score,last_color,combo_multiplier,
+                 timer_get_rate()*SOLVER_BUDGET_MS/1000,&res)) {
+    display_string("              ",(SCREEN_Y/2)+3,SCREEN_X-16,BLACK);
+    return;
+  }
+  snprintf(buf,BIG_BUFF,"EXPECT: %-6u",res.expected);
+  display_string(buf,(SCREEN_Y/2)+3,SCREEN_X-16,BLACK);
+  set_game_cursor(row_pos,col_pos,'\0');
+  row_pos=res.move.row;
+  col_pos=res.move.col;
+  set_game_cursor(row_pos,col_pos,'|');
 }
 
 /** @brief game_init initilizes a game session.
@@ -408,26 +720,33 @@ void game_init()
   combo_color=-1;
   selected_area_size=0;
   combo_multiplier=1;
+  combo[0]='\0';
+  history_clear();
   row_pos=0;col_pos=0;
   set_term_color(BLACK);
+  console_defer();
   clear_console();
-  int color,i,j;
-  sgenrand((unsigned long)game_seed);
-  for(i=0;i<NUM_ROW;i++) {
-    for(j=0;j<NUM_COL;j++) {
-      color=genrand()%3;
-      if(color==0)
-        color_arr[i][j]=BLUE;
-      if(color==1)
-        color_arr[i][j]=RED;
-      if(color==2)
-        color_arr[i][j]=GREEN;
-      set_block(i,j,color_arr[i][j]);
-    }
-  }
+  int i,j;
+  // ticks stand still on the tickless screens, so mix in the tsc
+  sgenrand((unsigned long)(game_seed^(unsigned int)rdtsc()));
+  board_clear(&board);
+  for(i=0;i<NUM_ROW;i++)
+    for(j=0;j<NUM_COL;j++)
+      board_set(&board,i,j,genrand()%BOARD_COLORS);
+  board_label(&board,&regions);
+  memset(hint_region,0,sizeof(hint_region));
+  render_mesh();
+  update_hint();
   display_prompts();
   set_game_cursor(row_pos,col_pos,'|');
+  console_flush();
+  timer_tickless(0);
+  clock_start();
+  autoplay_aimed=0;
   game_start();
+  clock_stop();
+  if(autoplay_on)
+    autoplay_report();
   return;
 }
 
@@ -442,16 +761,17 @@ void game_init()
 void set_game_cursor(int r,int c,char ch)
 {
   // The values of r,c are checked before they are sent
-  set_term_color(color_arr[r][c]);
+  char cursor[2];
+  cursor[0]=cursor[1]=ch;
+  set_term_color(block_attr(r,c));
   r*=2;c*=4;
   c+=2;r+=2;
+  console_defer();
   set_cursor(r,c+1);
-  putbyte(ch);
-  putbyte(ch);
+  putbytes(cursor,2);
   set_cursor(r+1,c+1);
-  putbyte(ch);
-  putbyte(ch);
-
+  putbytes(cursor,2);
+  console_flush();
 }
 
 /** @brief display_prompts displays the prompts
@@ -504,189 +824,153 @@ void display_string(char *str,int row,int col,int color)
 /** @brief sets a block to a particular color
  *         as per the game mesg requirements.
  *
+ *  @param r The row of the block
+ *  @param c The column of the block
+ *  @param color The color to draw it in
  *  @return Void.
  */
 void set_block(unsigned int r,unsigned int c,int color)
 {
-  int i,j;
+  set_blocks(r,c,1,color);
+}
+
+/** @brief sets a run of blocks in one row to a particular color
+ *
+ *  A block is two rows of four cells and the blocks of a row
+ *  are side by side, so the run is drawn as two span fills.
+ *  The color is remembered for render_columns.
+ *
+ *  @param r The row of the blocks
+ *  @param c The column of the first block
+ *  @param n The number of blocks
+ *  @param color The color to draw them in
+ *  @return Void.
+ */
+void set_blocks(unsigned int r,unsigned int c,int n,int color)
+{
+  uint16_t cell=CELL('\0',color);
+  int i;
+  for(i=0;i<n;i++)
+    drawn_arr[r][c+i]=color;
   r*=2;c*=4;
   c+=2;r+=2;
-  for(i=0;i<2;i++)
-    for(j=0;j<4;j++)
-      draw_char(r+i,c+j,'\0',color);
+  fill_cells(r,c,cell,4*n);
+  fill_cells(r+1,c,cell,4*n);
 }
 
 /** @brief Tick function, to be called by the timer interrupt handler
  *
  *  In a real game, this function would performs processing which
- *  should be invoked by timer interrupts. The function updates
- *  game score,time on screen and also helps initialize the seed
- *  Also performs differently for different game states.
+ *  should be invoked by timer interrupts. The function helps
+ *  initialize the seed. The game time is read from clock_ns and
+ *  redrawn by its own timer, see clock_start.
  *
  *  @param numTicks the timer ticks
  */
 void tick(unsigned int numTicks)
 {
-  if(curr_state==resume) {
-    game_time++;
-  }
   game_seed=numTicks;
-  int sec=game_time/100;
-  int msec=game_time%100;
+}
+
+/** @brief returns the time played so far
+ *
+ *  @return uint64_t the game time in nanoseconds
+ */
+static uint64_t played_ns()
+{
+  return game_time+(is_timing ? clock_ns()-resume_ns : 0);
+}
+
+/** @brief draws the game time and score if either has changed
+ *
+ *  Runs from the main loop, never in interrupt context, so it can
+ *  change the console color and cursor freely.
+ *
+ *  @param arg Unused
+ *  @return Void.
+ */
+static void draw_clock(void *arg)
+{
+  uint64_t now=played_ns();
+  int tenths=div64_32(now,NS_PER_TENTH);
   char buf[BIG_BUFF];
   int color;
+  if(!now || (tenths==drawn_time && score==drawn_score))
+    return;
+  drawn_time=tenths;
+  drawn_score=score;
   get_term_color(&color);
-  if(game_time) {
-    snprintf(buf,BIG_BUFF,"%d.%ds",sec,msec);
-    display_string(buf,SCREEN_Y-2,15,BLACK);
-    snprintf(buf,BIG_BUFF,"%d",score);
-    display_string(buf,SCREEN_Y-2,(NUM_COL*4)-4,BLACK);
-  }
+  snprintf(buf,BIG_BUFF,"%d.%ds",tenths/10,tenths%10);
+  display_string(buf,SCREEN_Y-2,15,BLACK);
+  snprintf(buf,BIG_BUFF,"%d",score);
+  display_string(buf,SCREEN_Y-2,(NUM_COL*4)-4,BLACK);
   set_term_color(color);
 }
 
-/** @brief compact contains the logic to compact the block mesh
+/** @brief timer callback asking for a clock redraw CLOCK_HZ times
+ *         a second
  *
- *  The function is divided into 2 halves
- *  - the falling of blocks
- *  - the column compaction
+ *  Runs in interrupt context, so the drawing itself is deferred to
+ *  the main loop.
  *
- *  the first part seeks the first empty block in a column
- *  and keeps replacing all blocks from that empty block onwards
- *  with a filled block
+ *  @param arg Unused
+ *  @return Void.
+ */
+static void clock_update(void *arg)
+{
+  defer_work(draw_clock,0);
+  clock_timer=timer_add(timer_get_rate()/CLOCK_HZ,clock_update,0);
+}
+
+/** @brief starts redrawing the clock while a game is played
  *
- *  the second part does the sma ething but with an empty
- *  column and then shifts the column inward(rightward in this case)
+ *  @return Void.
+ */
+void clock_start()
+{
+  clock_stop();
+  // the screen may have been cleared since the clock was last drawn
+  drawn_time=-1;
+  drawn_score=-1;
+  resume_ns=clock_ns();
+  is_timing=1;
+  clock_timer=timer_add(timer_get_rate()/CLOCK_HZ,clock_update,0);
+}
+
+/** @brief stops redrawing the clock, leaving its final value shown
  *
  *  @return Void.
  */
-void compact()
+void clock_stop()
 {
-  int i,j,k;
-  // block falling logic
-  for(i=0;i<NUM_COL;i++) {
-    for(j=NUM_ROW-1;j>0;j--) {
-      if(color_arr[j][i]==BLACK) {
-        for(k=j-1;k>=0;k--) {
-          if(color_arr[k][i]!=BLACK) {
-            color_arr[j][i]=color_arr[k][i];
-            color_arr[k][i]=BLACK;
-            j--;
-          }
-        }
-        break;
-      }
-    }
-  }
-  // column compaction algorithm
-  int count;
-  for(i=NUM_COL-1;i>0;i--) {
-    count=0;
-    for(j=0;j<NUM_ROW;j++) {
-      if(color_arr[j][i]==BLACK) {
-        count++;
-      }
-    }
-    if(count==NUM_ROW) {
-      for(k=i-1;k>=0;k--) {
-        count=0;
-        for(j=0;j<NUM_ROW;j++) {
-          if(color_arr[j][k]==BLACK) {
-            count++;
-          }
-        }
-        if(count!=NUM_ROW) {
-          for(j=0;j<NUM_ROW;j++) {
-            color_arr[j][i]=color_arr[j][k];
-            color_arr[j][k]=BLACK;
-          }
-          i--;
-        }
-      }
-      break;
-    }
+  uint32_t flags=get_eflags();
+  // the callback replaces clock_timer from the timer interrupt
+  disable_interrupts();
+  timer_cancel(clock_timer);
+  clock_timer=-1;
+  set_eflags(flags);
+  if(is_timing) {
+    game_time+=clock_ns()-resume_ns;
+    is_timing=0;
   }
+  draw_clock(0);
 }
 
 /** @brief contains the logic to detect game completion
  *
- *  apart from the obvious case of all the blocks being
- *  BLACK, the logic also checks every block adjacent to
- *  and above a certain block to not be of a certain color.
+ *  the game is complete once no region of two blocks or
+ *  more is left, which the region table keeps count of;
+ *  this covers the obvious case of an empty board as well.
  *  It also updates the high score if necessary.
  *
  *  @return int 1 - if complete, 0 otherwise
  */
 int game_complete()
 {
-  int row,col;
-  for(col = NUM_COL-1; col >=0; col--)
-  {
-    for(row = NUM_ROW-1; row > 0; row--)
-    {
-      int color = color_arr[row][col];
-      if(color == BLACK)
-        break;
-      else
-      {
-        if(color_arr[row - 1][col] == color)
-          return 0;
-        else if(col-1 >= 0)
-          if(color_arr[row][col-1] == color)
-            return 0;
-      }
-    }
-  }
+  if(regions.num_moves)
+    return 0;
   if(score>high_score)
     high_score=score;
   curr_state=complete;
   return 1;
 }
-
-/** @brief contains the delete block logic
- *
- *  Apart from the first block, for every other block
- *  deletion is performed immediately. For each block,
- *  its adjacent(top,bottom,left,right) blocks are checked
- *  to be of same color and then recursively called on each
- *  such block
- *
- *  @param row The row position in mesh of the block selected
- *  @param col The col position in mesh of the block selected
- *  @param init Whether it is the initial block or no (0 for initial)
- *  @return Void.
- */
-void deleteblocks(int row, int col,int init)
-{
-  if(row < 0 || row >= NUM_ROW || col < 0 || col >= NUM_COL)
-    return;
-  int color = color_arr[row][col];
-  if(init) {
-    color_arr[row][col] = BLACK;
-    selected_area_size++;
-  }
-  if(row - 1 >= 0) {
-    if(color_arr[row - 1][col] == color) {
-      color_arr[row][col] = BLACK;
-      deleteblocks(row - 1, col,1);
-    }
-  }
-  if(row + 1 < NUM_ROW) {
-    if(color_arr[row + 1][col] == color) {
-      color_arr[row][col]= BLACK;
-      deleteblocks(row + 1,col,1);
-    }
-  }
-  if(col - 1 >= 0) {
-    if(color_arr[row][col - 1] == color) {
-      color_arr[row][col] = BLACK;
-      deleteblocks(row, col - 1,1);
-    }
-  }
-  if(col + 1 < NUM_COL) {
-    if(color_arr[row][col + 1] == color) {
-      color_arr[row][col] = BLACK;
-      deleteblocks(row, col + 1,1);
-    }
-  }
-}
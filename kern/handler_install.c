@@ -5,6 +5,11 @@
  *  the buffer used by the keyboard. Contains the declarations of
  *  the insert and remove keyboard buffer functions.
  *
+ *  The keyboard buffer is a single-producer/single-consumer ring:
+ *  only the keyboard handler inserts and only readchar removes, and
+ *  each side writes just its own index, so neither ever has to turn
+ *  interrupts off.
+ *
  *  @author Sohil Habib (snhabib)
  *  @bug No known bugs.
  */
@@ -19,10 +24,17 @@
 #include <x86/keyhelp.h>
 #include <console.h>
 #include <x86/seg.h>
+#include <handler_install.h>
+#include <timer_handler.h>
+#include <timer_wheel.h>
+#include <clock.h>
 
-/* size of the keyboard buffer */
+/* size of the keyboard buffer, must be a power of two */
 #define MAX_SIZE 256
 
+/* turns a free running queue index into a buffer slot */
+#define Q_MASK (MAX_SIZE-1)
+
 #define LOWER_HALF 0xFFFF
 #define UPPER_HALF 0xFFFF0000
 #define TRAP_GATE_DEFAULT 0x8F
@@ -30,69 +42,84 @@
 /* fucntion pointer to tick function */
 void (*tick_addr)(unsigned int);
 
-/* front of the queue */
-unsigned int front;
-
-/* rear of the queue */
-unsigned int rear;
+/*
+ * Free running index of the next value to remove; written
+ * only by the consumer.
+ */
+static volatile unsigned int q_head;
 
-/* current size of th queue */
-unsigned int curr_size;
+/*
+ * Free running index of the next free slot; written only by
+ * the producer. The queue holds q_tail-q_head values.
+ */
+static volatile unsigned int q_tail;
 
 /* the keyboard buffer */
-unsigned int key_history[MAX_SIZE];
+static volatile unsigned int key_history[MAX_SIZE];
+
+/* timer tick at which each buffered value arrived */
+static volatile unsigned int key_ticks[MAX_SIZE];
 
-unsigned int remove_q();
-unsigned int insert_q(unsigned int val);
+/* time stamp counter at which each buffered value arrived */
+static volatile uint64_t key_tsc[MAX_SIZE];
 
 /** @brief insert_q inserts the value into queue buffer
  *
- *  the code takes care of the condition wherin buffer is full and
- *  overwrites the oldest value. rest all functions are like a
- *  normal queue.
+ *  Called only by the producer. The value is stored before the
+ *  tail is advanced, so the consumer never sees an unwritten slot.
+ *  When the buffer is full the new value is dropped, since only the
+ *  consumer may move the head.
  *
  *  @param val value to insert
- *  @return unsigned returns the value inserted
+ *  @param ticks timer tick at which the value arrived
+ *  @param tsc time stamp counter at which the value arrived
+ *  @return unsigned returns the value inserted, -1 if it was dropped
  */
-unsigned int insert_q(unsigned int val)
+unsigned int insert_q(unsigned int val,unsigned int ticks,uint64_t tsc)
 {
-  disable_interrupts();
-  if((++curr_size)==MAX_SIZE+1) {
-    curr_size--;
-    key_history[front]=val;
-    front=(front+1)%MAX_SIZE;
-    rear=(rear+1)%MAX_SIZE;
-    enable_interrupts();
-    return val;
-  }
-  rear=(rear+1)%MAX_SIZE;
-  key_history[rear]=val;
-  enable_interrupts();
+  unsigned int tail=q_tail;
+  if(tail-q_head==MAX_SIZE)
+    return -1;
+  key_history[tail & Q_MASK]=val;
+  key_ticks[tail & Q_MASK]=ticks;
+  key_tsc[tail & Q_MASK]=tsc;
+  q_tail=tail+1;
   return val;
 }
 
 /** @brief remove_q remove the value from the queue buffer
  *
- *  all functions are like a
- *  normal queue.
+ *  Called only by the consumer. The value is read before the head
+ *  is advanced, so the producer never reuses a slot still in use.
  *
- *  @return unsigned returns the value deleted
+ *  @param ticks where to store the tick at which the value arrived
+ *  @param tsc where to store the time stamp at which the value arrived
+ *  @return unsigned returns the value deleted, -1 if the queue is empty
  */
-unsigned int remove_q()
+unsigned int remove_q(unsigned int *ticks,uint64_t *tsc)
 {
-  disable_interrupts();
+  unsigned int head=q_head;
   unsigned int val;
-  if((--curr_size)==-1) {
-    curr_size++;
-    enable_interrupts();
+  if(head==q_tail)
     return -1;
-  }
-  val=key_history[front];
-  front=(front+1)%MAX_SIZE;
-  enable_interrupts();
+  val=key_history[head & Q_MASK];
+  *ticks=key_ticks[head & Q_MASK];
+  *tsc=key_tsc[head & Q_MASK];
+  q_head=head+1;
   return val;
 }
 
+/** @brief size_q returns the number of values in the queue buffer
+ *
+ *  Safe to call from either side of the queue.
+ *
+ *  @return unsigned the number of values queued
+ */
+unsigned int size_q()
+{
+  return q_tail-q_head;
+}
+
 /** @brief installs and sets up the timer,keyboard handlers and the
  *         console
  *
@@ -103,6 +130,9 @@ int handler_install(void (*tickback)(unsigned int))
   // initialize the console
   console_init();
 
+  // calibrate the high resolution clock
+  clock_init();
+
   // backup address of tick
   tick_addr=tickback;
 
@@ -113,15 +143,13 @@ int handler_install(void (*tickback)(unsigned int))
   base += 4;
   *(unsigned *)base=(((unsigned)timer_wrapper)&UPPER_HALF) | (TRAP_GATE_DEFAULT<<8);
 
-  // initialize timer wave type and value
-  outb(TIMER_MODE_IO_PORT,TIMER_SQUARE_WAVE);
-  outb(TIMER_PERIOD_IO_PORT,(TIMER_RATE/100)&0xFF);
-  outb(TIMER_PERIOD_IO_PORT,((TIMER_RATE/100)&0xFF00)>>8);
+  // initialize timer wave type and value, and the software timers
+  timer_set_rate(TIMER_DEFAULT_HZ);
+  timer_wheel_init(get_ticks());
 
   // initialize queue buffer defaults
-  front=0;
-  rear=-1;
-  curr_size=0;
+  q_head=0;
+  q_tail=0;
 
   // initialize keyboard IDT
   base=(idt_base()+(KEY_IDT_ENTRY)*8);
@@ -5,7 +5,10 @@
  *  @author Sohil Habib (snhabib)
  */
 
+#include <stdint.h>
+
 void (*tick_addr)(unsigned int);
-unsigned int remove_q();
-unsigned int insert_q(unsigned int val);
+unsigned int remove_q(unsigned int *ticks,uint64_t *tsc);
+unsigned int insert_q(unsigned int val,unsigned int ticks,uint64_t tsc);
+unsigned int size_q();
 int handler_install(void (*tickback)(unsigned int));
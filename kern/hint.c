@@ -0,0 +1,58 @@
+/** @file hint.c
+ *  @brief the hint engine
+ *
+ *  Each region is scored from its size and color alone, so with the
+ *  regions of the board already labeled a hint is one pass over the
+ *  region table.
+ *
+ *  @author Sohil Habib (snhabib)
+ *  @bug No known bugs.
+ */
+
+/* necessary includes */
+#include <hint.h>
+
+int hint_score(const board_move_t *m,int last_color,int combo_multiplier)
+{
+  if(m->color==last_color)
+    return m->size*(combo_multiplier+1);
+  return m->size;
+}
+
+int hint_play(play_state_t *s,int id)
+{
+  uint16_t region[BOARD_COLS];
+  board_move_t m;
+  unsigned int cols;
+  int points;
+  board_region_move(&s->regions,id,&m);
+  points=hint_score(&m,s->last_color,s->combo_multiplier);
+  board_region_mask(&s->regions,m.row,m.col,region);
+  cols=board_remove(&s->board,region);
+  board_relabel(&s->board,&s->regions,cols);
+  if(m.color==s->last_color)
+    s->combo_multiplier++;
+  else
+    s->combo_multiplier=1;
+  s->last_color=m.color;
+  s->score+=points;
+  return points;
+}
+
+int hint_best(const board_regions_t *r,int last_color,int combo_multiplier,
+              board_move_t *best)
+{
+  board_move_t m;
+  int id,s,best_score=0;
+  for(id=0;id<BOARD_MAX_REGIONS;id++) {
+    if(r->size[id]<2)
+      continue;
+    board_region_move(r,id,&m);
+    s=hint_score(&m,last_color,combo_multiplier);
+    if(s>best_score) {
+      best_score=s;
+      *best=m;
+    }
+  }
+  return best_score;
+}
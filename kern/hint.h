@@ -0,0 +1,53 @@
+/** @file hint.h
+ *  @brief function definitions for the hint engine
+ *
+ *  The hint engine picks the move that scores the most right now,
+ *  by the rule game_start scores moves with: the size of the region
+ *  times the combo multiplier it would earn. It also plays moves
+ *  by that rule for the engines that search ahead.
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+#include <board.h>
+
+/** @brief a game in progress */
+typedef struct play_state {
+  board_t board;
+  /* the regions of the board, kept up to date */
+  board_regions_t regions;
+  int score;
+  /* the color id of the region last cleared, -1 if none */
+  int last_color;
+  int combo_multiplier;
+} play_state_t;
+
+/** @brief returns what a move would score
+ *
+ *  @param m The move
+ *  @param last_color The color id of the region last cleared, -1 if none
+ *  @param combo_multiplier The current combo multiplier
+ *  @return int the score of the move
+ */
+int hint_score(const board_move_t *m,int last_color,int combo_multiplier);
+
+/** @brief plays a move, scoring it
+ *
+ *  @param s The game
+ *  @param id The region the move clears, of two blocks or more
+ *  @return int the points the move earned
+ */
+int hint_play(play_state_t *s,int id);
+
+/** @brief finds the move that scores the most
+ *
+ *  Ties go to the region with the lowest id.
+ *
+ *  @param r The regions of the board
+ *  @param last_color The color id of the region last cleared, -1 if none
+ *  @param combo_multiplier The current combo multiplier
+ *  @param best Where to store the move
+ *  @return int the score of the move, 0 if there is no move left
+ */
+int hint_best(const board_regions_t *r,int last_color,int combo_multiplier,
+              board_move_t *best);
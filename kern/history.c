@@ -0,0 +1,195 @@
+/** @file history.c
+ *  @brief the undo/redo history
+ *
+ *  The moves are packed into a ring of bytes, oldest first, with the
+ *  moves that can be redone after the ones that can be undone. A
+ *  move is stored as
+ *
+ *  - 2 bytes, the mask of the columns the region has blocks in
+ *  - 2 bytes, the mask of the columns left holding blocks
+ *  - 1 byte each, the color, the last color plus one and the combo
+ *  - 2 bytes per column in the first mask, the region in it
+ *  - 1 byte, the length of the whole record
+ *
+ *  so the length of a record can be read from either end, and the
+ *  ring can be walked both ways.
+ *
+ *  @author Sohil Habib (snhabib)
+ *  @bug No known bugs.
+ */
+
+/* necessary includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <malloc.h>
+#include <history.h>
+
+/* bytes of a record besides its region masks, the length included */
+#define RECORD_FIXED 8
+
+/* the ring, and its size in bytes */
+static uint8_t *ring;
+static int ring_size;
+
+/* where the oldest move starts, and where the next one goes */
+static int first;
+static int next;
+
+/* bytes taken by the moves that can be undone and redone */
+static int undo_bytes;
+static int redo_bytes;
+
+/** @brief returns the ring index some bytes away
+ *
+ *  @param pos The index
+ *  @param n The number of bytes, negative to go back
+ *  @return int the index
+ */
+static int advance(int pos,int n)
+{
+  pos=(pos+n)%ring_size;
+  return pos<0 ? pos+ring_size : pos;
+}
+
+/** @brief reads a 16 bit value from the ring
+ *
+ *  @param pos The index of its first byte
+ *  @return unsigned the value
+ */
+static unsigned int get16(int pos)
+{
+  return ring[pos] | (ring[advance(pos,1)]<<8);
+}
+
+/** @brief writes a 16 bit value to the ring
+ *
+ *  @param pos The index of its first byte
+ *  @param v The value
+ *  @return Void.
+ */
+static void put16(int pos,unsigned int v)
+{
+  ring[pos]=v & 0xFF;
+  ring[advance(pos,1)]=v>>8;
+}
+
+/** @brief returns the length of the record a column mask needs
+ *
+ *  @param touched The columns the region has blocks in
+ *  @return int the length in bytes
+ */
+static int record_len(unsigned int touched)
+{
+  int len=RECORD_FIXED;
+  for(;touched;touched&=touched-1)
+    len+=2;
+  return len;
+}
+
+/** @brief unpacks a record
+ *
+ *  @param pos The index of its first byte
+ *  @param m Where to store the move
+ *  @return int the length of the record
+ */
+static int read_record(int pos,history_move_t *m)
+{
+  unsigned int touched=get16(pos);
+  int c,p=advance(pos,RECORD_FIXED-1);
+  m->kept=get16(advance(pos,2));
+  m->color=ring[advance(pos,4)];
+  m->last_color=ring[advance(pos,5)]-1;
+  m->combo_multiplier=ring[advance(pos,6)];
+  for(c=0;c<BOARD_COLS;c++) {
+    m->region[c]=0;
+    if(touched & (1<<c)) {
+      m->region[c]=get16(p);
+      p=advance(p,2);
+    }
+  }
+  return record_len(touched);
+}
+
+int history_budget(int bytes)
+{
+  uint8_t *buf=NULL;
+  if(bytes<0)
+    return -1;
+  if(bytes) {
+    buf=smalloc(bytes);
+    if(!buf)
+      return -1;
+  }
+  if(ring)
+    sfree(ring,ring_size);
+  ring=buf;
+  ring_size=bytes;
+  history_clear();
+  return 0;
+}
+
+void history_clear()
+{
+  first=next=0;
+  undo_bytes=redo_bytes=0;
+}
+
+void history_push(const history_move_t *m)
+{
+  unsigned int touched=0;
+  int c,len,p;
+  for(c=0;c<BOARD_COLS;c++)
+    if(m->region[c])
+      touched|=1<<c;
+  len=record_len(touched);
+  redo_bytes=0;
+  if(len>ring_size) {
+    history_clear();
+    return;
+  }
+  while(undo_bytes+len>ring_size) {
+    c=record_len(get16(first));
+    first=advance(first,c);
+    undo_bytes-=c;
+  }
+  put16(next,touched);
+  put16(advance(next,2),m->kept);
+  ring[advance(next,4)]=m->color;
+  ring[advance(next,5)]=m->last_color+1;
+  ring[advance(next,6)]=m->combo_multiplier;
+  p=advance(next,RECORD_FIXED-1);
+  for(c=0;c<BOARD_COLS;c++) {
+    if(touched & (1<<c)) {
+      put16(p,m->region[c]);
+      p=advance(p,2);
+    }
+  }
+  ring[p]=len;
+  next=advance(next,len);
+  undo_bytes+=len;
+}
+
+int history_undo(history_move_t *m)
+{
+  int len;
+  if(!undo_bytes)
+    return -1;
+  len=ring[advance(next,-1)];
+  next=advance(next,-len);
+  read_record(next,m);
+  undo_bytes-=len;
+  redo_bytes+=len;
+  return 0;
+}
+
+int history_redo(history_move_t *m)
+{
+  int len;
+  if(!redo_bytes)
+    return -1;
+  len=read_record(next,m);
+  next=advance(next,len);
+  undo_bytes+=len;
+  redo_bytes-=len;
+  return 0;
+}
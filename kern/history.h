@@ -0,0 +1,67 @@
+/** @file history.h
+ *  @brief function definitions for the undo/redo history
+ *
+ *  Each move is kept as what it takes to undo it: the region it
+ *  removed, the columns it left holding blocks, and the combo it
+ *  started from. Undoing a move with board_restore costs about as
+ *  much as the move did.
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+#include <board.h>
+
+/** @brief a move of the history */
+typedef struct history_move {
+  /* the region removed, as one mask per column */
+  uint16_t region[BOARD_COLS];
+  /* the color id of the region */
+  int color;
+  /* the columns left holding blocks, as board_kept returned */
+  unsigned int kept;
+  /* the color id of the region cleared before, -1 if none */
+  int last_color;
+  /* the combo multiplier before the move */
+  int combo_multiplier;
+} history_move_t;
+
+/** @brief sets how many bytes the history may take
+ *
+ *  The history is allocated from malloc_lmm and is emptied. Moves
+ *  take 8 bytes plus 2 per column they removed blocks from; once the
+ *  budget is used up the oldest moves are forgotten.
+ *
+ *  @param bytes The budget, 0 to keep no history
+ *  @return int 0 on success, -1 if bytes is negative or the memory
+ *          could not be allocated
+ */
+int history_budget(int bytes);
+
+/** @brief forgets every move
+ *
+ *  @return Void.
+ */
+void history_clear();
+
+/** @brief records a move that is about to be played
+ *
+ *  The moves that were undone are forgotten.
+ *
+ *  @param m The move
+ *  @return Void.
+ */
+void history_push(const history_move_t *m);
+
+/** @brief steps back over the last move played
+ *
+ *  @param m Where to store the move, to be undone by the caller
+ *  @return int 0 on success, -1 if there is no move to undo
+ */
+int history_undo(history_move_t *m);
+
+/** @brief steps forward over the last move undone
+ *
+ *  @param m Where to store the move, to be played again by the caller
+ *  @return int 0 on success, -1 if there is no move to redo
+ */
+int history_redo(history_move_t *m);
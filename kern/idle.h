@@ -0,0 +1,16 @@
+/** @file idle.h
+ *  @brief function definition for the idle wait
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+/** @brief wait_interrupt enables interrupts and halts until one arrives
+ *
+ *  sti only takes effect after the instruction that follows it, so
+ *  no interrupt can be taken between the sti and the hlt. A caller
+ *  that disabled interrupts, found nothing to do and then calls this
+ *  therefore cannot miss the wakeup it is waiting for.
+ *
+ *  @return Void, with interrupts enabled.
+ */
+void wait_interrupt();
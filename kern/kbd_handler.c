@@ -2,6 +2,12 @@
  *  @brief the file contains the code for the keyboard handler and the readchar api function
  *         needed to get input from kyboard
  *
+ *  The handler only queues raw scancodes and schedules a bottom half
+ *  as deferred work. The bottom half decodes them in batches into a
+ *  queue of key press events that readchar and read_key_event take
+ *  from in constant time; it also runs whenever input is read, so a
+ *  reader never misses a key still waiting to be decoded.
+ *
  *  @author Sohil Habib (snhabib)
  *  @bug No known bugs.
  */
@@ -10,33 +16,190 @@
 #include <stdio.h>
 #include <x86/asm.h>
 #include <x86/keyhelp.h>
+#include <scancode.h>
 #include <handler_install.h>
 #include <x86/interrupt_defines.h>
 #include <p1kern.h>
+#include <console.h>
+#include <idle.h>
+#include <kbd_handler.h>
+#include <timer_handler.h>
+#include <latency.h>
+#include <deferred.h>
+
+/* rows moved by one page of the scrollback view */
+#define VIEW_PAGE (CONSOLE_HEIGHT-1)
+
+/* size of the key event queue, must be a power of two */
+#define EVENT_SIZE 64
+
+/* turns a free running event index into a queue slot */
+#define EVENT_MASK (EVENT_SIZE-1)
+
+/* scancodes translated per call of the batch decoder */
+#define SCAN_BATCH 16
+
+/*
+ * Decoded key presses waiting for readchar. Both ends are only
+ * touched outside interrupt context, so no locking is needed.
+ */
+static key_event_t events[EVENT_SIZE];
+static unsigned int event_head;
+static unsigned int event_tail;
+
+/** @brief handles the console hotkeys
+ *
+ *  @param code A decoded key press
+ *  @return int 1 if the key was a hotkey and has been consumed,
+ *          0 otherwise
+ */
+static int console_hotkey(kh_type code)
+{
+  int ch=KH_GETCHAR(code);
+  // alt+F1, alt+F2, ... switch between the virtual consoles
+  if(KH_ALT(code) && ch>=KHE_F1 && ch<KHE_F1+NUM_CONSOLES) {
+    // the latency debug screen is refreshed each time it is shown
+    if(ch-KHE_F1==LAT_CONSOLE)
+      latency_report();
+    console_switch(ch-KHE_F1);
+    return 1;
+  }
+  // shift+up/down page through the console history
+  if(KH_SHIFT(code) && (ch==KHE_ARROW_UP || ch==KHE_ARROW_DOWN)) {
+    console_view_scroll(ch==KHE_ARROW_UP ? VIEW_PAGE : -VIEW_PAGE);
+    return 1;
+  }
+  return 0;
+}
+
+/** @brief the keyboard bottom half
+ *
+ *  Decodes every scancode the handler has queued since the last
+ *  run, a batch at a time through the table-driven translator. Key
+ *  presses carrying a character are stamped and queued as events;
+ *  releases, modifier-only codes and hotkeys are consumed here, so
+ *  they never take space in the event queue. When the event queue
+ *  is full further presses are dropped.
+ *
+ *  @param arg Unused
+ *  @return Void.
+ */
+static void kbd_bottom_half(void *arg)
+{
+  int scans[SCAN_BATCH];
+  unsigned int ticks[SCAN_BATCH];
+  uint64_t tsc[SCAN_BATCH];
+  kh_type codes[SCAN_BATCH];
+  int i,n;
+  kh_type code;
+  key_event_t *ev;
+  do {
+    for(n=0;n<SCAN_BATCH && (scans[n]=remove_q(&ticks[n],&tsc[n]))!=-1;n++);
+    process_scancodes(scans,codes,n);
+    for(i=0;i<n;i++) {
+      code=codes[i];
+      if(!KH_HASDATA(code) || !KH_ISMAKE(code))
+        continue;
+      if(console_hotkey(code))
+        continue;
+      if(event_tail-event_head==EVENT_SIZE)
+        continue;
+      ev=&events[event_tail & EVENT_MASK];
+      ev->code=code;
+      ev->ticks=ticks[i];
+      ev->tsc=tsc[i];
+      event_tail++;
+    }
+  } while(n==SCAN_BATCH);
+}
+
+int read_key_event(key_event_t *ev)
+{
+  // the program has finished with the key it read before
+  latency_key_done();
+  kbd_bottom_half(NULL);
+  if(event_head==event_tail)
+    return -1;
+  *ev=events[event_head & EVENT_MASK];
+  event_head++;
+  latency_key_read(ev->tsc);
+  return 0;
+}
 
 int readchar(void)
 {
-  unsigned int val=remove_q();
-  if((int)val==-1)
+  key_event_t ev;
+  if(read_key_event(&ev)<0)
     return -1;
-  int code=process_scancode(val);
-  if(KH_HASDATA(code)) {
-    if(KH_ISMAKE(code)) {
-    return KH_GETCHAR(code);
-    }
+  console_view_live();
+  return KH_GETCHAR(ev.code);
+}
+
+/** @brief halts the cpu until the next interrupt if no input is queued
+ *
+ *  The queue is checked with interrupts off and wait_interrupt()
+ *  turns them back on atomically with the halt, so a key arriving
+ *  after the check still wakes the cpu. Work deferred by an interrupt
+ *  handler counts as input, so it is run without waiting. A timed
+ *  wait also arms its tickless deadline inside that window, so the
+ *  deadline cannot pass unnoticed before the halt.
+ *
+ *  @param start The tick the wait started at
+ *  @param ticks The number of ticks to wait for, 0 to wait for a key
+ *  @return Void.
+ */
+static void wait_input(unsigned int start,unsigned int ticks)
+{
+  disable_interrupts();
+  if(size_q() || deferred_pending() || (ticks && get_ticks()-start>=ticks)) {
+    enable_interrupts();
+    return;
+  }
+  if(ticks)
+    timer_deadline(ticks-(get_ticks()-start));
+  wait_interrupt();
+}
+
+int readchar_wait()
+{
+  int ch;
+  while((ch=readchar())==-1) {
+    run_deferred();
+    wait_input(0,0);
+  }
+  return ch;
+}
+
+int readchar_timeout(unsigned int ticks)
+{
+  unsigned int start=get_ticks();
+  int ch;
+  while((ch=readchar())==-1) {
+    run_deferred();
+    if(get_ticks()-start>=ticks)
+      return -1;
+    // the timer interrupt ends the halt, in tickless mode once the
+    // deadline asked for in wait_input has passed
+    wait_input(start,ticks);
   }
-  return -1;
+  return ch;
 }
 
 /** @brief the handler for the keyboard
  *
- *  inserts the key entered into the buffer
- *  and acknowledges interrupt recieved
+ *  inserts the key entered into the buffer, stamped with the
+ *  tick and time stamp counter it arrived at, schedules the
+ *  bottom half to decode it, and acknowledges interrupt recieved
  *
  *  @return Void.
  */
 void kbd_handler()
 {
-  insert_q((unsigned)ind(KEYBOARD_PORT));
+  uint64_t tsc=rdtsc();
+  insert_q((unsigned)ind(KEYBOARD_PORT),get_ticks(),tsc);
+  defer_work(kbd_bottom_half,NULL);
+  // recorded before the acknowledge, while the PIC holds back the
+  // next keyboard interrupt that would update the same histogram
+  latency_record(LAT_ISR,rdtsc()-tsc);
   outb(INT_CTL_PORT,INT_ACK_CURRENT);
 }
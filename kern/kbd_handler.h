@@ -0,0 +1,48 @@
+/** @file kbd_handler.h
+ *  @brief function definition for the key event and blocking
+ *         keyboard reads
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+#include <stdint.h>
+#include <x86/keyhelp.h>
+
+/** @brief a decoded key press */
+typedef struct key_event {
+  /* the character, modifiers and make bit; read with the KH_ macros */
+  kh_type code;
+  /* the timer tick at which the key's interrupt arrived */
+  unsigned int ticks;
+  /* the time stamp counter at which the key's interrupt arrived */
+  uint64_t tsc;
+} key_event_t;
+
+/** @brief read_key_event returns the next key press
+ *
+ *  @param ev Where to store the event
+ *  @return int 0 if an event was stored, -1 if none is pending
+ */
+int read_key_event(key_event_t *ev);
+
+/** @brief readchar_wait returns the next character, halting the
+ *         cpu until one is typed
+ *
+ *  Work deferred by interrupt handlers is run while waiting. Must be
+ *  called with interrupts enabled.
+ *
+ *  @return int the character read
+ */
+int readchar_wait();
+
+/** @brief readchar_timeout returns the next character typed within
+ *         the given number of timer ticks
+ *
+ *  The cpu is halted while there is no input, and work deferred by
+ *  interrupt handlers is run while waiting. Must be called with
+ *  interrupts enabled.
+ *
+ *  @param ticks The number of timer ticks to wait for
+ *  @return int the character read, -1 if none arrived in time
+ */
+int readchar_timeout(unsigned int ticks);
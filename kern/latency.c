@@ -0,0 +1,144 @@
+/** @file latency.c
+ *  @brief the file contains the input latency histograms and the
+ *         debug screen that shows them
+ *
+ *  The keyboard handler records its own run time, so the LAT_ISR
+ *  histogram is written in interrupt context, before the interrupt
+ *  is acknowledged so a nested keyboard interrupt cannot interleave
+ *  with it; the other stages are only written outside it. A report may read a count that is being
+ *  updated, which at worst leaves it one sample behind.
+ *
+ *  @author Sohil Habib (snhabib)
+ *  @bug No known bugs.
+ */
+
+/* necessary includes */
+#include <stdio.h>
+#include <simics.h>
+#include <x86/asm.h>
+#include <p1kern.h>
+#include <console.h>
+#include <latency.h>
+#include <clock.h>
+#include <div64.h>
+
+/* size of a debug screen line */
+#define LINE_SIZE 81
+
+/* the names the stages are reported under */
+static const char *stage_names[LAT_STAGES]={"isr","dequeue","render"};
+
+/* samples counted per stage and bucket */
+static volatile unsigned int hist[LAT_STAGES][LAT_BUCKETS];
+
+/* the longest time seen per stage, saturated to 32 bits */
+static volatile unsigned int max_cycles[LAT_STAGES];
+
+/* interrupt stamp of the last key read, 0 once it is rendered or dropped */
+static uint64_t pending_tsc;
+
+/** @brief picks the histogram bucket of a measurement
+ *
+ *  Bucket i counts times from 2^(i+LAT_MIN_SHIFT) cycles up to twice
+ *  that; the first and last buckets also take everything below and
+ *  above them.
+ *
+ *  @param cycles The measured time
+ *  @return int the bucket index
+ */
+static int bucket(uint64_t cycles)
+{
+  int b;
+  if(cycles>>32)
+    return LAT_BUCKETS-1;
+  if(!(unsigned int)cycles)
+    return 0;
+  b=31-__builtin_clz((unsigned int)cycles)-LAT_MIN_SHIFT;
+  if(b<0)
+    return 0;
+  if(b>=LAT_BUCKETS)
+    return LAT_BUCKETS-1;
+  return b;
+}
+
+void latency_record(int stage,uint64_t cycles)
+{
+  unsigned int c=(cycles>>32) ? 0xFFFFFFFF : (unsigned int)cycles;
+  hist[stage][bucket(cycles)]++;
+  if(c>max_cycles[stage])
+    max_cycles[stage]=c;
+}
+
+void latency_key_read(uint64_t tsc)
+{
+  latency_record(LAT_DEQUEUE,rdtsc()-tsc);
+  pending_tsc=tsc;
+}
+
+void latency_key_done()
+{
+  pending_tsc=0;
+}
+
+void latency_render_done()
+{
+  if(!pending_tsc)
+    return;
+  latency_record(LAT_RENDER,rdtsc()-pending_tsc);
+  pending_tsc=0;
+}
+
+/** @brief draws the histograms on the debug screen
+ *
+ *  One row per bucket, one column per stage, with the longest
+ *  times on the last row.
+ *
+ *  @return Void.
+ */
+static void draw_report()
+{
+  char line[LINE_SIZE];
+  int prev,b,len;
+
+  prev=console_select(LAT_CONSOLE);
+  console_defer();
+  clear_console();
+  len=snprintf(line,LINE_SIZE,"input latency in cycles, samples per stage");
+  putbytes(line,len);
+  set_cursor(1,0);
+  len=snprintf(line,LINE_SIZE,"%11s %10s %10s %10s","from",
+               stage_names[LAT_ISR],stage_names[LAT_DEQUEUE],
+               stage_names[LAT_RENDER]);
+  putbytes(line,len);
+  for(b=0;b<LAT_BUCKETS;b++) {
+    set_cursor(2+b,0);
+    len=snprintf(line,LINE_SIZE,"%11u %10u %10u %10u",
+                 b ? 1u<<(b+LAT_MIN_SHIFT) : 0,hist[LAT_ISR][b],
+                 hist[LAT_DEQUEUE][b],hist[LAT_RENDER][b]);
+    putbytes(line,len);
+  }
+  set_cursor(2+LAT_BUCKETS,0);
+  len=snprintf(line,LINE_SIZE,"%11s %10u %10u %10u","max",
+               max_cycles[LAT_ISR],max_cycles[LAT_DEQUEUE],
+               max_cycles[LAT_RENDER]);
+  putbytes(line,len);
+  console_flush();
+  console_select(prev);
+}
+
+void latency_report()
+{
+  int s,b;
+
+  draw_report();
+
+  for(s=0;s<LAT_STAGES;s++) {
+    sim_printf("latency %s: max %u cycles, %u us",stage_names[s],
+               max_cycles[s],
+               (unsigned int)div64_32(clock_cycles_ns(max_cycles[s]),1000));
+    for(b=0;b<LAT_BUCKETS;b++)
+      if(hist[s][b])
+        sim_printf("  >= %u cycles: %u",b ? 1u<<(b+LAT_MIN_SHIFT) : 0,
+                   hist[s][b]);
+  }
+}
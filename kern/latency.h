@@ -0,0 +1,73 @@
+/** @file latency.h
+ *  @brief function definition for the input latency histograms
+ *
+ *  Every key press is stamped with the time stamp counter when the
+ *  keyboard interrupt arrives. The time it then takes to reach each
+ *  later stage is counted in a histogram with one bucket per power
+ *  of two cycles.
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+#include <stdint.h>
+
+/* the stages a key press is measured at */
+#define LAT_ISR     0  /* cycles spent in the keyboard handler */
+#define LAT_DEQUEUE 1  /* interrupt to readchar handing out the key */
+#define LAT_RENDER  2  /* interrupt to the key's screen update being flushed */
+#define LAT_STAGES  3
+
+/* number of histogram buckets per stage */
+#define LAT_BUCKETS 22
+
+/* cycles counted by the first bucket, as a power of two */
+#define LAT_MIN_SHIFT 8
+
+/* virtual console the histograms are drawn on */
+#define LAT_CONSOLE 1
+
+/** @brief counts one measurement in a stage's histogram
+ *
+ *  @param stage The stage measured, one of the LAT_ values
+ *  @param cycles The measured time in time stamp counter cycles
+ *  @return Void.
+ */
+void latency_record(int stage,uint64_t cycles);
+
+/** @brief notes the key press the program has just read
+ *
+ *  Records the dequeue stage and keeps the stamp until the game
+ *  has drawn the key's update.
+ *
+ *  @param tsc The time stamp of the key's interrupt
+ *  @return Void.
+ */
+void latency_key_read(uint64_t tsc);
+
+/** @brief notes that the program is done with the last key read
+ *
+ *  A key that led to no screen update is dropped here, so that the
+ *  render stage never counts an update made for something else.
+ *
+ *  @return Void.
+ */
+void latency_key_done();
+
+/** @brief notes that the update for the last key read is on screen
+ *
+ *  Called by the game once it has handled the key and flushed
+ *  everything it drew for it. Records the render stage of the key,
+ *  if one is pending, and clears it.
+ *
+ *  @return Void.
+ */
+void latency_render_done();
+
+/** @brief reports the histograms
+ *
+ *  Draws them on the LAT_CONSOLE debug screen and writes them to
+ *  the simulator log with sim_printf.
+ *
+ *  @return Void.
+ */
+void latency_report();
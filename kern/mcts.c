@@ -0,0 +1,246 @@
+/** @file mcts.c
+ *  @brief the Monte Carlo tree search solver
+ *
+ *  Each round walks down the tree by UCB1, replaying the moves on a
+ *  copy of the board, adds the children of the node it stops at if
+ *  that node was visited before, and then plays uniformly random
+ *  moves drawn with genrand() until the game ends. The final score
+ *  is added to every node on the way.
+ *
+ *  The nodes of a node's children are taken together from the
+ *  arena, so the tree is a flat array with no pointers, and a new
+ *  search resets it by resetting the count of nodes in use.
+ *
+ *  UCB1 is evaluated in fixed point. The exploration term of a child
+ *  is sqrt(ln N / n) scaled by the best final score seen, which keeps
+ *  it in the units of the mean whatever the size of the board.
+ *
+ *  @author Sohil Habib (snhabib)
+ *  @bug No known bugs.
+ */
+
+/* necessary includes */
+#include <stdint.h>
+#include <simics.h>
+#include <malloc.h>
+#include <RNG/mt19937int.h>
+#include <timer_handler.h>
+#include <deferred.h>
+#include <clock.h>
+#include <div64.h>
+#include <hint.h>
+#include <mcts.h>
+
+/* ln 2 in 16.16 fixed point */
+#define LN2_FP16 45426
+
+/** @brief a node of the search tree */
+typedef struct mcts_node {
+  /* the block of the region cleared to get here */
+  uint8_t row;
+  uint8_t col;
+  /* the number of children, -1 until they are added */
+  int16_t num_children;
+  /* the arena index of the first child */
+  int first_child;
+  /* the number of games played through the node */
+  unsigned int visits;
+  /* the sum of their final scores */
+  uint64_t total;
+} mcts_node_t;
+
+/* the node arena, from malloc_lmm */
+static mcts_node_t *arena;
+
+/* the number of arena nodes in use */
+static int arena_used;
+
+/* the game at the root, and the game being played out */
+static play_state_t root_state;
+static play_state_t state;
+
+/* the nodes walked through in a round, root first */
+static int path[BOARD_MAX_MOVES+1];
+
+/** @brief takes nodes from the arena
+ *
+ *  @param n The number of nodes
+ *  @return int the index of the first, -1 if the arena is full
+ */
+static int new_nodes(int n)
+{
+  int i;
+  if(arena_used+n>MCTS_ARENA_NODES)
+    return -1;
+  for(i=arena_used;i<arena_used+n;i++) {
+    arena[i].num_children=-1;
+    arena[i].visits=0;
+    arena[i].total=0;
+  }
+  arena_used+=n;
+  return arena_used-n;
+}
+
+/** @brief adds the children of a node, one per move
+ *
+ *  The node is left without children if the arena is full.
+ *
+ *  @param node The node
+ *  @param s The game at the node
+ *  @return Void.
+ */
+static void expand(int node,const play_state_t *s)
+{
+  int id,first,k=0;
+  first=new_nodes(s->regions.num_moves);
+  if(first<0)
+    return;
+  for(id=0;id<BOARD_MAX_REGIONS;id++) {
+    if(s->regions.size[id]<2)
+      continue;
+    arena[first+k].row=s->regions.row[id];
+    arena[first+k].col=s->regions.col[id];
+    k++;
+  }
+  arena[node].first_child=first;
+  arena[node].num_children=k;
+}
+
+/** @brief returns the integer square root
+ *
+ *  @param x The number
+ *  @return unsigned the largest r with r*r <= x
+ */
+static unsigned int isqrt(unsigned int x)
+{
+  unsigned int r=0,bit=1u<<30;
+  while(bit>x)
+    bit>>=2;
+  for(;bit;bit>>=2) {
+    if(x>=r+bit) {
+      x-=r+bit;
+      r=(r>>1)+bit;
+    }
+    else
+      r>>=1;
+  }
+  return r;
+}
+
+/** @brief picks the child to walk down to by UCB1
+ *
+ *  A child never visited goes first.
+ *
+ *  @param node The node
+ *  @param scale The best final score seen
+ *  @return int the child
+ */
+static int select_child(int node,unsigned int scale)
+{
+  mcts_node_t *p=&arena[node];
+  unsigned int ln_fp16,value,best_value=0;
+  int i,child,best=p->first_child;
+  // no child has been visited before its parent
+  if(!p->visits)
+    return best;
+  // log2 N from the top bit, turned into ln N
+  ln_fp16=(31-__builtin_clz(p->visits))*LN2_FP16;
+  for(i=0;i<p->num_children;i++) {
+    child=p->first_child+i;
+    if(!arena[child].visits)
+      return child;
+    // sqrt of a 16.16 ratio is 8.8 fixed point
+    value=div64_32(arena[child].total,arena[child].visits)+
+          ((scale*isqrt(ln_fp16/arena[child].visits))>>8);
+    if(value>best_value) {
+      best_value=value;
+      best=child;
+    }
+  }
+  return best;
+}
+
+/** @brief plays random moves until the game ends
+ *
+ *  @param s The game
+ *  @return unsigned the final score
+ */
+static unsigned int rollout(play_state_t *s)
+{
+  int id,k;
+  while(s->regions.num_moves) {
+    k=genrand()%s->regions.num_moves;
+    for(id=0;s->regions.size[id]<2 || k--;id++);
+    hint_play(s,id);
+  }
+  return s->score;
+}
+
+int mcts_search(const board_t *b,const board_regions_t *r,int score,
+                int last_color,int combo_multiplier,unsigned int budget,
+                mcts_result_t *res)
+{
+  unsigned int start=get_ticks();
+  uint64_t start_ns=clock_ns(),ns;
+  unsigned int final,scale=1,us;
+  int node,depth,i,best;
+
+  if(!r->num_moves)
+    return -1;
+  if(!arena) {
+    arena=smalloc(MCTS_ARENA_NODES*sizeof(mcts_node_t));
+    if(!arena)
+      return -1;
+  }
+  root_state.board=*b;
+  root_state.regions=*r;
+  root_state.score=score;
+  root_state.last_color=last_color;
+  root_state.combo_multiplier=combo_multiplier;
+  arena_used=0;
+  new_nodes(1);
+  expand(0,&root_state);
+  res->rollouts=0;
+  do {
+    state=root_state;
+    node=0;
+    depth=0;
+    path[0]=0;
+    while(arena[node].num_children>0) {
+      node=select_child(node,scale);
+      hint_play(&state,state.regions.id[arena[node].row][arena[node].col]);
+      path[++depth]=node;
+    }
+    if(arena[node].num_children<0 && arena[node].visits) {
+      expand(node,&state);
+      if(arena[node].num_children>0) {
+        node=arena[node].first_child;
+        hint_play(&state,state.regions.id[arena[node].row][arena[node].col]);
+        path[++depth]=node;
+      }
+    }
+    final=rollout(&state);
+    if(final>scale)
+      scale=final;
+    for(i=0;i<=depth;i++) {
+      arena[path[i]].visits++;
+      arena[path[i]].total+=final;
+    }
+    res->rollouts++;
+    // let queued scancodes be decoded and the clock drawn meanwhile
+    run_deferred();
+  } while(get_ticks()-start<budget);
+
+  best=arena[0].first_child;
+  for(i=0;i<arena[0].num_children;i++)
+    if(arena[arena[0].first_child+i].visits>arena[best].visits)
+      best=arena[0].first_child+i;
+  board_region_move(r,r->id[arena[best].row][arena[best].col],&res->move);
+  res->expected=div64_32(arena[best].total,arena[best].visits);
+  ns=clock_ns()-start_ns;
+  us=div64_32(ns,1000);
+  res->rollouts_per_sec=us ? div64_32((uint64_t)res->rollouts*1000000,us) : 0;
+  sim_printf("mcts: %u rollouts in %u us, %u rollouts/s, %d nodes",
+             res->rollouts,us,res->rollouts_per_sec,arena_used);
+  return 0;
+}
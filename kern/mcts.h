@@ -0,0 +1,47 @@
+/** @file mcts.h
+ *  @brief function definitions for the Monte Carlo tree search solver
+ *
+ *  The solver plays random games out from the board, steering more
+ *  of them down the moves that have ended well so far, and
+ *  recommends the move most of them went through.
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+#include <board.h>
+
+/* number of tree nodes in the arena */
+#define MCTS_ARENA_NODES 65536
+
+/** @brief what a search found */
+typedef struct mcts_result {
+  /* the recommended move */
+  board_move_t move;
+  /* the mean final score of the games played through the move */
+  unsigned int expected;
+  /* the number of random games played */
+  unsigned int rollouts;
+  /* the number of random games played per second */
+  unsigned int rollouts_per_sec;
+} mcts_result_t;
+
+/** @brief searches for the best move
+ *
+ *  The tree nodes come from a fixed arena, which is allocated on
+ *  the first search and reused by every later one. Once it is full
+ *  the tree stops growing and the search goes on with random games
+ *  from its leaves.
+ *
+ *  @param b The board
+ *  @param r The regions of the board
+ *  @param score The score so far
+ *  @param last_color The color id of the region last cleared, -1 if none
+ *  @param combo_multiplier The current combo multiplier
+ *  @param budget The number of timer ticks the search may take
+ *  @param res Where to store what the search found
+ *  @return int 0 on success, -1 if the game is over or the arena
+ *          could not be allocated
+ */
+int mcts_search(const board_t *b,const board_regions_t *r,int score,
+                int last_color,int combo_multiplier,unsigned int budget,
+                mcts_result_t *res);
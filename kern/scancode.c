@@ -0,0 +1,525 @@
+/** @file scancode.c
+ *  @brief the table-driven scancode translator
+ *
+ *  A port of the reference kernel's keyhelp.c, which stays as it is
+ *  under 410kern/. Ordinary keys are translated by a lookup in one
+ *  of eight tables, one per combination of the shift, caps lock and
+ *  control states, built at compile time from a single key list;
+ *  only the keys that drive the keyboard state machine are decoded
+ *  by hand. The results are the same kh_type values the reference
+ *  process_scancode returns.
+ *
+ *  Based on the 15-410 reference keyboard code by Steve Muckle,
+ *  zra, mpa and nwf.
+ *
+ *  @author Sohil Habib (snhabib)
+ *  @bug No known bugs.
+ */
+/*@{*/
+
+#include <x86/keyhelp.h>
+#include <scancode.h>
+
+/**
+ * This is returned as the upper bits of the result of
+ * scancode_translate and may be interrogated more readily by
+ * the KH_ macros in keyhelp.h
+ *
+ * WARNING:
+ * The bottom bits overlap with the KH_RESULT_ codes in the
+ * return value.
+ */
+static short key_state = 0;
+
+  /** Currently processing a PRINT SCREEN BREAK sequence */
+#define KH_PRSCR_UP_SCAN    0x0008
+  /** Currently processing a PRINT SCREEN MAKE sequence */
+#define KH_PRSCR_DOWN_SCAN  0x0004
+  /** Currently processing a PAUSE/BREAK (MAKE) sequence */
+#define KH_PAUSE_SCAN       0x0002
+  /** Currently processing an extended sequence (E0 prefix) */
+#define KH_EXTENDED_SCAN    0x0001
+static short key_internal_state = 0;
+
+static int key_sequence = 0;
+
+#define KHS_SHIFT_CORE (key_state & (KH_LSHIFT_KEY | KH_RSHIFT_KEY)) 
+#define KHS_CTL_CORE (key_state & (KH_LCONTROL_KEY | KH_RCONTROL_KEY)) 
+
+/**@{ Modifier planes of the translation tables */
+  /** Either shift key is down */
+#define KHP_SHIFT 0x1
+  /** CapsLock is on */
+#define KHP_CAPS  0x2
+  /** Either control key is down */
+#define KHP_CTL   0x4
+  /** Number of planes */
+#define KHP_COUNT 8
+/**@}*/
+
+/**@{ Per-plane translation rules, evaluated at compile time.
+ *
+ * Each gives the translated code of a key in plane p, given its
+ * control (cc), shifted (s) and unshifted (u) codes.
+ */
+#define KHT_FIXED(p,cc,s,u) (u)
+#define KHT_SHIFT(p,cc,s,u) (((p) & KHP_SHIFT) ? (s) : (u))
+#define KHT_SHIFTCTL(p,cc,s,u) \
+  (((p) & KHP_CTL) ? (cc) : KHT_SHIFT(p,cc,s,u))
+#define KHT_SHIFTCAPSCTL(p,cc,s,u) \
+  (((p) & KHP_CTL) ? (cc) : \
+   ((!((p) & KHP_SHIFT) != !((p) & KHP_CAPS)) ? (s) : (u)))
+/**@}*/
+
+#define KHN KH_RESULT_NUMPAD
+
+/**
+ * The table-driven simple scancodes, as
+ * X(scancode, rule, control, shifted, unshifted, result flags).
+ *
+ * Keys which change the keyboard state (the modifiers, the locks and
+ * the pieces of the PAUSE sequence) are not listed here; they are
+ * handled by process_simple_scan itself.
+ */
+#define KH_SIMPLE_KEYS(X,p) \
+  X(p, 0x01, FIXED,        0,    0,    0x1B, 0)   /* Escape */ \
+  X(p, 0x02, SHIFT,        0,    '!',  '1',  0) \
+  X(p, 0x03, SHIFTCTL,     0x00, '@',  '2',  0) \
+  X(p, 0x04, SHIFT,        0,    '#',  '3',  0) \
+  X(p, 0x05, SHIFT,        0,    '$',  '4',  0) \
+  X(p, 0x06, SHIFT,        0,    '%',  '5',  0) \
+  X(p, 0x07, SHIFTCTL,     0x1E, '^',  '6',  0) \
+  X(p, 0x08, SHIFT,        0,    '&',  '7',  0) \
+  X(p, 0x09, SHIFT,        0,    '*',  '8',  0) \
+  X(p, 0x0A, SHIFT,        0,    '(',  '9',  0) \
+  X(p, 0x0B, SHIFT,        0,    ')',  '0',  0) \
+  X(p, 0x0C, SHIFTCTL,     0x1F, '_',  '-',  0) \
+  X(p, 0x0D, SHIFT,        0,    '+',  '=',  0) \
+  X(p, 0x0E, FIXED,        0,    0,    '\b', 0)   /* Backspace */ \
+  X(p, 0x0F, FIXED,        0,    0,    '\t', 0)   /* Tab */ \
+  X(p, 0x10, SHIFTCAPSCTL, 0x11, 'Q',  'q',  0) \
+  X(p, 0x11, SHIFTCAPSCTL, 0x17, 'W',  'w',  0) \
+  X(p, 0x12, SHIFTCAPSCTL, 0x05, 'E',  'e',  0) \
+  X(p, 0x13, SHIFTCAPSCTL, 0x12, 'R',  'r',  0) \
+  X(p, 0x14, SHIFTCAPSCTL, 0x14, 'T',  't',  0) \
+  X(p, 0x15, SHIFTCAPSCTL, 0x19, 'Y',  'y',  0) \
+  X(p, 0x16, SHIFTCAPSCTL, 0x15, 'U',  'u',  0) \
+  X(p, 0x17, SHIFTCAPSCTL, 0x09, 'I',  'i',  0) \
+  X(p, 0x18, SHIFTCAPSCTL, 0x0F, 'O',  'o',  0) \
+  X(p, 0x19, SHIFTCAPSCTL, 0x10, 'P',  'p',  0) \
+  X(p, 0x1A, SHIFTCAPSCTL, 0x1B, '{',  '[',  0) \
+  X(p, 0x1B, SHIFTCAPSCTL, 0x1D, '}',  ']',  0) \
+  X(p, 0x1C, FIXED,        0,    0,    '\n', 0)   /* Enter */ \
+  X(p, 0x1E, SHIFTCAPSCTL, 0x01, 'A',  'a',  0) \
+  X(p, 0x1F, SHIFTCAPSCTL, 0x13, 'S',  's',  0) \
+  X(p, 0x20, SHIFTCAPSCTL, 0x04, 'D',  'd',  0) \
+  X(p, 0x21, SHIFTCAPSCTL, 0x06, 'F',  'f',  0) \
+  X(p, 0x22, SHIFTCAPSCTL, 0x07, 'G',  'g',  0) \
+  X(p, 0x23, SHIFTCAPSCTL, 0x08, 'H',  'h',  0) \
+  X(p, 0x24, SHIFTCAPSCTL, 0x0A, 'J',  'j',  0) \
+  X(p, 0x25, SHIFTCAPSCTL, 0x0B, 'K',  'k',  0) \
+  X(p, 0x26, SHIFTCAPSCTL, 0x0C, 'L',  'l',  0) \
+  X(p, 0x27, SHIFT,        0,    ':',  ';',  0) \
+  X(p, 0x28, SHIFT,        0,    '\"', '\'', 0) \
+  X(p, 0x29, SHIFT,        0,    '~',  '`',  0) \
+  X(p, 0x2B, SHIFTCTL,     0x1C, '|',  '\\', 0) \
+  X(p, 0x2C, SHIFTCAPSCTL, 0x1A, 'Z',  'z',  0) \
+  X(p, 0x2D, SHIFTCAPSCTL, 0x18, 'X',  'x',  0) \
+  X(p, 0x2E, SHIFTCAPSCTL, 0x03, 'C',  'c',  0) \
+  X(p, 0x2F, SHIFTCAPSCTL, 0x16, 'V',  'v',  0) \
+  X(p, 0x30, SHIFTCAPSCTL, 0x02, 'B',  'b',  0) \
+  X(p, 0x31, SHIFTCAPSCTL, 0x0E, 'N',  'n',  0) \
+  X(p, 0x32, SHIFTCAPSCTL, 0x0D, 'M',  'm',  0) \
+  X(p, 0x33, SHIFT,        0,    '<',  ',',  0) \
+  X(p, 0x34, SHIFT,        0,    '>',  '.',  0) \
+  X(p, 0x35, SHIFT,        0,    '?',  '/',  0) \
+  X(p, 0x37, FIXED,        0,    0,    '*',  KHN) \
+  X(p, 0x39, FIXED,        0,    0,    ' ',  0)   /* Space bar */ \
+  X(p, 0x3B, FIXED,        0,    0,    KHE_F1,  0) \
+  X(p, 0x3C, FIXED,        0,    0,    KHE_F2,  0) \
+  X(p, 0x3D, FIXED,        0,    0,    KHE_F3,  0) \
+  X(p, 0x3E, FIXED,        0,    0,    KHE_F4,  0) \
+  X(p, 0x3F, FIXED,        0,    0,    KHE_F5,  0) \
+  X(p, 0x40, FIXED,        0,    0,    KHE_F6,  0) \
+  X(p, 0x41, FIXED,        0,    0,    KHE_F7,  0) \
+  X(p, 0x42, FIXED,        0,    0,    KHE_F8,  0) \
+  X(p, 0x43, FIXED,        0,    0,    KHE_F9,  0) \
+  X(p, 0x44, FIXED,        0,    0,    KHE_F10, 0) \
+  X(p, 0x47, FIXED,        0,    0,    '7',  KHN) \
+  X(p, 0x48, FIXED,        0,    0,    '8',  KHN) \
+  X(p, 0x49, FIXED,        0,    0,    '9',  KHN) \
+  X(p, 0x4A, FIXED,        0,    0,    '-',  KHN) \
+  X(p, 0x4B, FIXED,        0,    0,    '4',  KHN) \
+  X(p, 0x4C, FIXED,        0,    0,    '5',  KHN) \
+  X(p, 0x4D, FIXED,        0,    0,    '6',  KHN) \
+  X(p, 0x4E, FIXED,        0,    0,    '+',  KHN) \
+  X(p, 0x4F, FIXED,        0,    0,    '1',  KHN) \
+  X(p, 0x50, FIXED,        0,    0,    '2',  KHN) \
+  X(p, 0x51, FIXED,        0,    0,    '3',  KHN) \
+  X(p, 0x52, FIXED,        0,    0,    '0',  KHN) \
+  X(p, 0x53, FIXED,        0,    0,    '.',  KHN) \
+  X(p, 0x57, FIXED,        0,    0,    KHE_F11, 0) \
+  X(p, 0x58, FIXED,        0,    0,    KHE_F12, 0)
+
+/**
+ * The table-driven extended (E0 prefixed) scancodes, in the same
+ * form. None of them depend on the modifiers.
+ */
+#define KH_EXTENDED_KEYS(X,p) \
+  X(p, 0x1C, FIXED,        0,    0,    '\n', KHN) \
+  X(p, 0x35, FIXED,        0,    0,    '/',  KHN) \
+  X(p, 0x48, FIXED,        0,    0,    KHE_ARROW_UP,    0) \
+  X(p, 0x4B, FIXED,        0,    0,    KHE_ARROW_LEFT,  0) \
+  X(p, 0x4D, FIXED,        0,    0,    KHE_ARROW_RIGHT, 0) \
+  X(p, 0x50, FIXED,        0,    0,    KHE_ARROW_DOWN,  0) \
+  X(p, 0x53, FIXED,        0,    0,    0x7F, 0)   /* DEL */
+
+/**@{ Table entry generators for the key lists above */
+#define KHX_CODE(p,sc,rule,cc,s,u,f) [sc] = KHT_##rule(p,cc,s,u),
+#define KHX_RAW(p,sc,rule,cc,s,u,f) [sc] = (u),
+#define KHX_FLAGS(p,sc,rule,cc,s,u,f) [sc] = (f),
+#define KH_SIMPLE_PLANE(p) { KH_SIMPLE_KEYS(KHX_CODE,p) }
+/**@}*/
+
+/**
+ * Translated codes of the simple scancodes, one table per modifier
+ * plane (a combination of KHP_ bits).
+ */
+static const unsigned char kh_simple_code[KHP_COUNT][0x80] = {
+  KH_SIMPLE_PLANE(0), KH_SIMPLE_PLANE(1), KH_SIMPLE_PLANE(2),
+  KH_SIMPLE_PLANE(3), KH_SIMPLE_PLANE(4), KH_SIMPLE_PLANE(5),
+  KH_SIMPLE_PLANE(6), KH_SIMPLE_PLANE(7),
+};
+
+/** Raw codes of the simple scancodes; zero if not table-driven. */
+static const unsigned char kh_simple_raw[0x80] = {
+  KH_SIMPLE_KEYS(KHX_RAW,0)
+};
+
+/** KH_RESULT_ flags of the simple scancodes. */
+static const unsigned char kh_simple_flags[0x80] = {
+  KH_SIMPLE_KEYS(KHX_FLAGS,0)
+};
+
+/** Codes of the extended scancodes; zero if not table-driven. */
+static const unsigned char kh_extended_raw[0x80] = {
+  KH_EXTENDED_KEYS(KHX_RAW,0)
+};
+
+/** KH_RESULT_ flags of the extended scancodes. */
+static const unsigned char kh_extended_flags[0x80] = {
+  KH_EXTENDED_KEYS(KHX_FLAGS,0)
+};
+
+/**
+ * Assembles a kh_type result from its raw and translated codes,
+ * in the way common to the simple and extended paths.
+ *
+ * @param res Result flags already gathered.
+ * @param code The translated code.
+ * @param rcode The raw code.
+ *
+ * @return A partially constructed kh_type.
+ */
+static kh_type
+finish_scan(kh_type res, unsigned char code, unsigned char rcode)
+{
+  if ( rcode != KHE_UNDEFINED && code != KHE_UNDEFINED )
+    res |= (KH_RESULT_HASDATA << KH_RMODS_SHIFT);
+  else
+    code = 0x00;
+
+  return res | (code << KH_CHAR_SHIFT)
+            | (rcode << KH_RAWCHAR_SHIFT)
+            | (KH_RESULT_HASRAW << KH_RMODS_SHIFT);
+}
+
+/**
+ * This function performs the mapping
+ * from simple scancodes to chars.
+ *
+ * Ordinary keys are two table lookups: the plane is chosen from the
+ * current modifier state and indexed by the scancode. Only the keys
+ * which drive the keyboard state machine are decoded by hand.
+ *
+ * @param scancode a simple scancode.
+ * @param pressed 0 if released, nonzero if pressed.
+ *
+ * @return A partially constructed kh_type.
+ */
+static kh_type
+process_simple_scan(int scancode, int pressed)
+{
+  unsigned char code = 0x80;
+  unsigned char rcode;
+  int plane;
+
+  scancode &= 0x7F;
+  rcode = kh_simple_raw[scancode];
+  if (rcode)
+  {
+    plane = (KHS_SHIFT_CORE ? KHP_SHIFT : 0)
+          | ((key_state & KH_CAPS_LOCK) ? KHP_CAPS : 0)
+          | (KHS_CTL_CORE ? KHP_CTL : 0);
+    return finish_scan(kh_simple_flags[scancode] << KH_RMODS_SHIFT,
+                       kh_simple_code[plane][scancode], rcode);
+  }
+
+  switch(scancode)
+  {
+  case 0x1D:
+    if((key_internal_state & KH_PAUSE_SCAN) && (key_sequence == 0))
+    {
+      /* Stage 1 of a pause sequence */
+      key_sequence++;
+      return 0;
+    } else {
+      key_internal_state &= ~KH_PAUSE_SCAN;
+      key_sequence = 0;
+    }
+    rcode=KHE_LCTL;
+    if(pressed)
+      key_state |= KH_LCONTROL_KEY;
+    else
+      key_state &= ~KH_LCONTROL_KEY;
+    break;
+  case 0x2A:
+    rcode = KHE_LSHIFT;
+    if(pressed)
+      key_state |= KH_LSHIFT_KEY;
+    else
+      key_state &= ~KH_LSHIFT_KEY;
+    break;
+  case 0x36:
+    rcode = KHE_RSHIFT;
+    if(pressed)
+      key_state |= KH_RSHIFT_KEY;
+    else
+      key_state &= ~KH_RSHIFT_KEY;
+    break;
+  case 0x38:
+    rcode = KHE_LALT;
+    if(pressed)
+      key_state |= KH_LALT_KEY;
+    else
+      key_state &= ~KH_LALT_KEY;
+    break;
+  case 0x3A:
+    rcode = KHE_CAPSLOCK;
+    if(pressed)
+    {
+      if(key_state & KH_CAPS_LOCK)
+        key_state &= ~KH_CAPS_LOCK;
+      else
+        key_state |= KH_CAPS_LOCK;
+    }
+    break;
+  case 0x45:
+    if((key_internal_state & KH_PAUSE_SCAN) && (key_sequence == 1))
+    {
+      /* Stage 2 of a pause sequence */
+      key_sequence++;
+      return 0;
+    } else {
+      key_internal_state &= ~KH_PAUSE_SCAN;
+      key_sequence = 0;
+    }
+    rcode = KHE_NUMLOCK;
+    if(pressed)
+    {
+      if(key_state & KH_NUM_LOCK)
+        key_state &= ~KH_NUM_LOCK;
+      else
+        key_state |= KH_NUM_LOCK;
+    }
+    break;
+  case 0xE1 & 0x7F:
+    if(!(key_internal_state & KH_PAUSE_SCAN))
+    {
+      /* Stage 0 of a pause sequence */
+      key_internal_state |= KH_PAUSE_SCAN;
+      key_sequence = 0;
+      return 0;
+    } else if ((key_internal_state & KH_PAUSE_SCAN) && (key_sequence == 2)) {
+      key_sequence++;
+      return 0;
+    } else {
+      key_internal_state &= ~KH_PAUSE_SCAN;
+      key_sequence = 0;
+    }
+    /* FALLTHROUGH */
+  default:
+    rcode = code = KHE_UNDEFINED;
+    break;
+  }
+
+  return finish_scan(0, code, rcode);
+}
+
+/**
+ * Processes extended scan codes.  Notably, this includes
+ * the arrow keys as well as some of the more unusual keys
+ * on the keyboard.
+ *
+ * Like process_simple_scan, ordinary keys come from a table and
+ * only the modifiers and PRINT SCREEN are decoded by hand.
+ *
+ * @param keypress the extended scancode.
+ * @param 0 if released. non-zero if pressed.
+ *
+ * @return A partially constructed kh_type.
+ */
+static kh_type
+process_extended_scan(int keypress, int pressed)
+{
+  unsigned char code = 0x80;
+  unsigned char rcode;
+
+  /* Intermediate states in multiple byte scancodes should return
+   * zero from this function, rather than returning a RESULT code.
+   */
+
+  keypress &= 0x7F;
+  key_internal_state &= ~KH_EXTENDED_SCAN;
+  rcode = kh_extended_raw[keypress];
+  if (rcode)
+    return finish_scan(kh_extended_flags[keypress] << KH_RMODS_SHIFT,
+                       rcode, rcode);
+
+  /* Put the flag back for the PRINT SCREEN stages below, which
+   * decide for themselves whether to keep it.
+   */
+  key_internal_state |= KH_EXTENDED_SCAN;
+
+  switch(keypress)
+  {
+    case 0x1D:
+      /* Right control key */
+      rcode = KHE_RCTL;
+      if(pressed)
+        key_state |= KH_RCONTROL_KEY;
+      else
+        key_state &= ~KH_RCONTROL_KEY;
+      break;
+    case 0x2A:
+      /* Stage 0 of PRINT SCREEN MAKE and Stage 1 of PRINT SCREEN BREAK */
+      if(key_internal_state & KH_PRSCR_UP_SCAN)
+      {
+        rcode = code = KHE_PRINT_SCREEN;
+        key_internal_state &= ~KH_PRSCR_UP_SCAN;
+      } else if (!(key_internal_state & KH_PRSCR_UP_SCAN)) {
+        key_internal_state |= KH_PRSCR_DOWN_SCAN;
+        key_internal_state &= ~KH_EXTENDED_SCAN;
+        return 0;
+      } else {
+        rcode = code = KHE_UNDEFINED;
+      }
+      break;
+    case 0x37:
+      /* Stage 1 of PRINT SCREEN MAKE and Stage 0 of PRINT SCREEN BREAK */
+      if(key_internal_state & KH_PRSCR_DOWN_SCAN)
+      {
+        rcode = code = KHE_PRINT_SCREEN;
+        key_internal_state &= ~KH_PRSCR_DOWN_SCAN;
+      } else if (!(key_internal_state & KH_PRSCR_DOWN_SCAN)) {
+        key_internal_state |= KH_PRSCR_UP_SCAN;
+        key_internal_state &= ~KH_EXTENDED_SCAN;
+        return 0;
+      } else {
+        rcode = code = KHE_UNDEFINED;
+      }
+      break;
+    case 0x38:
+      /* Right alt key */
+      rcode = KHE_RALT;
+      if(pressed)
+        key_state |= KH_RALT_KEY;
+      else
+        key_state &= ~KH_RALT_KEY;
+      break;
+    default:
+      rcode = code = KHE_UNDEFINED;
+      break;
+  }
+
+  key_internal_state &= ~KH_EXTENDED_SCAN;
+
+  return finish_scan(0, code, rcode);
+}
+
+  /** The entrypoint to the keyboard processing library.
+   *
+   * @param keypress A raw scancode as returned by the keyboard hardware.
+   * @return A kh_type indicating the keyboard modifier key states, result
+   *         modifier bits, and potentially ASCII/410 Upper Code Plane
+   *         translations.
+   */
+kh_type scancode_translate(int keypress) {
+  kh_type res;
+  int pressed = !(keypress & 0x80);
+  int keycode = keypress & 0x7F;
+  
+  if (key_internal_state & KH_EXTENDED_SCAN)
+    res = process_extended_scan(keycode, pressed);
+  else
+  {
+    switch(keypress & 0xFF)
+    {
+      case 0x9D:
+        if ((key_internal_state & KH_PAUSE_SCAN) && (key_sequence == 3))
+        {
+          key_sequence++;
+          return 0;
+        } else {
+          key_internal_state &= ~KH_PAUSE_SCAN;
+          key_sequence = 0;
+        }
+        goto deflt;
+      case 0xC5:
+        if ((key_internal_state & KH_PAUSE_SCAN) && (key_sequence == 4))
+        {
+          key_internal_state &= ~KH_PAUSE_SCAN;
+          /* Pause sequence completed */
+          res = (KHE_PAUSE << KH_CHAR_SHIFT)
+                | (KHE_PAUSE << KH_RAWCHAR_SHIFT)
+                | (KH_RESULT_HASDATA << KH_RMODS_SHIFT);
+          break;
+        }
+        key_internal_state &= ~KH_PAUSE_SCAN;
+        key_sequence = 0;
+        goto deflt;
+      case 0xE0:
+        key_internal_state |= KH_EXTENDED_SCAN;
+        /* Return no result for this intermediate state */
+        return key_state << KH_STATE_SHIFT;
+      default:
+deflt:
+        key_internal_state &= ~(KH_PRSCR_UP_SCAN | KH_PRSCR_DOWN_SCAN);
+        res = process_simple_scan(keycode, pressed);
+    }
+  }
+
+  if(pressed)
+    res |= KH_RESULT_MAKE << KH_RMODS_SHIFT;
+
+  res |= (key_state & KH_STATE_SMASK) << KH_STATE_SHIFT;
+
+  return res;
+}
+
+  /** Translates a batch of scancodes in one call.
+   *
+   * Equivalent to calling scancode_translate on each scancode in turn.
+   *
+   * @param keypresses The raw scancodes, in the order they arrived.
+   * @param results Where to store the kh_type of each scancode.
+   * @param n The number of scancodes.
+   */
+void process_scancodes(const int *keypresses, kh_type *results, int n) {
+  int i;
+
+  for (i = 0; i < n; i++)
+    results[i] = scancode_translate(keypresses[i]);
+}
+
+/*@}*/
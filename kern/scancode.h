@@ -0,0 +1,29 @@
+/** @file scancode.h
+ *  @brief function definitions for the scancode translator
+ *
+ *  The translator keeps the keyboard state, so every scancode must
+ *  go through it once, in the order the keyboard sent them.
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+#include <x86/keyhelp.h>
+
+/** @brief translates a scancode
+ *
+ *  @param keypress A raw scancode as read from the keyboard
+ *  @return kh_type the key states, result bits and translation, as
+ *          process_scancode returns them
+ */
+kh_type scancode_translate(int keypress);
+
+/** @brief translates a batch of scancodes
+ *
+ *  Equivalent to calling scancode_translate on each scancode in turn.
+ *
+ *  @param keypresses The raw scancodes, in the order they arrived
+ *  @param results Where to store the kh_type of each scancode
+ *  @param n The number of scancodes
+ *  @return Void.
+ */
+void process_scancodes(const int *keypresses,kh_type *results,int n);
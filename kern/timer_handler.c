@@ -1,6 +1,14 @@
 /** @file timer_handler.c
  *  @brief the file contains the code for the timer handler
  *
+ *  The timer runs in one of two modes. In periodic mode the PIT
+ *  raises an interrupt every tick. In tickless mode it is set up in
+ *  one-shot mode and only programmed while a deadline is pending,
+ *  each shot covering as many whole ticks as fit in the counter, so
+ *  an idle screen takes no timer interrupts at all. The tick count
+ *  then only moves on when a shot expires, which is enough for
+ *  anything that waits through timer_deadline().
+ *
  *  @author Sohil Habib (snhabib)
  *  @bug No known bugs.
  */
@@ -8,23 +16,212 @@
 /* necessary includes */
 #include <stdio.h>
 #include <x86/asm.h>
+#include <x86/eflags.h>
 #include <x86/timer_defines.h>
 #include <x86/interrupt_defines.h>
 #include <handler_install.h>
+#include <timer_handler.h>
+#include <timer_wheel.h>
+
+/* mode command latching the count of counter 0 */
+#define TIMER_LATCH 0x00
+
+/* largest count the PIT takes */
+#define MAX_COUNT 0xFFFF
 
 /* the number of clock ticks*/
-static unsigned int numTicks;
+static volatile unsigned int numTicks;
+
+/* the tick rate in Hz */
+static unsigned int rate;
+
+/* PIT counts per tick */
+static unsigned int tick_counts;
+
+/* nonzero while the timer is in tickless mode */
+static int is_tickless;
+
+/* nonzero while deadline is pending */
+static int has_deadline;
+
+/* tick the next tickless interrupt is wanted at */
+static unsigned int deadline;
+
+/* ticks covered by the shot in flight, 0 if none */
+static unsigned int shot_ticks;
+
+/* PIT counts the shot in flight was started with */
+static unsigned int shot_counts;
+
+/* counts of the current tick already elapsed before the shot began */
+static unsigned int carry;
+
+/* the last tick passed to tick_addr */
+static unsigned int told_ticks;
+
+/** @brief loads a count into counter 0 in the given mode
+ *
+ *  @param mode The mode command, TIMER_SQUARE_WAVE or TIMER_ONE_SHOT
+ *  @param counts The count to load
+ *  @return Void.
+ */
+static void program_pit(int mode,unsigned int counts)
+{
+  outb(TIMER_MODE_IO_PORT,mode);
+  outb(TIMER_PERIOD_IO_PORT,counts&0xFF);
+  outb(TIMER_PERIOD_IO_PORT,(counts&0xFF00)>>8);
+}
+
+/** @brief starts a shot towards the pending deadline
+ *
+ *  Must be called with interrupts disabled, or from the handler.
+ *
+ *  @return Void.
+ */
+static void start_shot()
+{
+  unsigned int left=deadline-numTicks;
+  if((int)left<=0)
+    left=1;
+  if(left>MAX_COUNT/tick_counts)
+    left=MAX_COUNT/tick_counts;
+  shot_ticks=left;
+  shot_counts=left*tick_counts-carry;
+  carry=0;
+  program_pit(TIMER_ONE_SHOT,shot_counts);
+}
+
+/** @brief stops the shot in flight and counts the ticks it covered
+ *
+ *  The part of a tick already elapsed is kept in carry, so the next
+ *  shot loses no time. Must be called with interrupts disabled.
+ *
+ *  @return int 1 if the shot was stopped, 0 if it has already
+ *          expired and its interrupt is pending
+ */
+static int cut_shot()
+{
+  unsigned int remaining,elapsed;
+  outb(TIMER_MODE_IO_PORT,TIMER_LATCH);
+  remaining=inb(TIMER_PERIOD_IO_PORT);
+  remaining|=inb(TIMER_PERIOD_IO_PORT)<<8;
+  // once it reaches zero a one-shot counter wraps and keeps counting
+  if(!remaining || remaining>shot_counts)
+    return 0;
+  elapsed=shot_ticks*tick_counts-remaining;
+  numTicks+=elapsed/tick_counts;
+  carry=elapsed%tick_counts;
+  shot_ticks=0;
+  return 1;
+}
 
 /** @brief the handler for the timer
  *
- *  incrememnts the number of ticks and sends it to tick_addr
- *  and then acknowledges the interrupt received
+ *  incrememnts the number of ticks, runs the timers that are due
+ *  and sends it to tick_addr and then acknowledges the interrupt
+ *  received. In tickless mode the ticks covered by the shot are
+ *  added and the next shot is started if the deadline is still
+ *  ahead, or if a pending timer needs one. tick_addr is called
+ *  once for every tick added since it was last called, including
+ *  ticks counted when a shot was cut short.
  *
  *  @return Void.
  */
 void timer_handler()
 {
-  numTicks++;
-  tick_addr(numTicks);
+  unsigned int next;
+  if(is_tickless) {
+    numTicks+=shot_ticks;
+    shot_ticks=0;
+    if(has_deadline && (int)(deadline-numTicks)>0)
+      start_shot();
+    else
+      has_deadline=0;
+  }
+  else
+    numTicks++;
+  timer_wheel_run(numTicks);
+  if(is_tickless && (next=timer_wheel_next(numTicks)))
+    timer_deadline(next);
+  while(told_ticks!=numTicks)
+    tick_addr(++told_ticks);
   outb(INT_CTL_PORT,INT_ACK_CURRENT);
 }
+
+unsigned int get_ticks()
+{
+  return numTicks;
+}
+
+int timer_set_rate(unsigned int hz)
+{
+  uint32_t flags;
+  int cut;
+  if(!hz || TIMER_RATE/hz<1 || TIMER_RATE/hz>MAX_COUNT)
+    return -1;
+  flags=get_eflags();
+  disable_interrupts();
+  // ticks already covered by a shot are counted at the old rate
+  cut=is_tickless && shot_ticks && cut_shot();
+  rate=hz;
+  tick_counts=TIMER_RATE/hz;
+  carry=0;
+  if(!is_tickless)
+    program_pit(TIMER_SQUARE_WAVE,tick_counts);
+  else if(cut)
+    start_shot();
+  set_eflags(flags);
+  return 0;
+}
+
+unsigned int timer_get_rate()
+{
+  return rate;
+}
+
+void timer_tickless(int on)
+{
+  uint32_t flags=get_eflags();
+  unsigned int next;
+  disable_interrupts();
+  if(on && !is_tickless) {
+    // the counter stops until a count is loaded
+    outb(TIMER_MODE_IO_PORT,TIMER_ONE_SHOT);
+    is_tickless=1;
+    has_deadline=0;
+    shot_ticks=0;
+    carry=0;
+    if((next=timer_wheel_next(numTicks)))
+      timer_deadline(next);
+  }
+  else if(!on && is_tickless) {
+    if(shot_ticks)
+      cut_shot();
+    is_tickless=0;
+    shot_ticks=0;
+    program_pit(TIMER_SQUARE_WAVE,tick_counts);
+  }
+  set_eflags(flags);
+}
+
+void timer_deadline(unsigned int ticks)
+{
+  uint32_t flags;
+  unsigned int when;
+  if(!is_tickless)
+    return;
+  flags=get_eflags();
+  disable_interrupts();
+  when=numTicks+(ticks ? ticks : 1);
+  if(!has_deadline || (int)(when-deadline)<0) {
+    deadline=when;
+    if(!has_deadline) {
+      has_deadline=1;
+      start_shot();
+    }
+    // a shot ending past the new deadline is cut short
+    else if(shot_ticks && (int)(when-(numTicks+shot_ticks))<0 && cut_shot())
+      start_shot();
+  }
+  set_eflags(flags);
+}
@@ -0,0 +1,52 @@
+/** @file timer_handler.h
+ *  @brief function definition for reading the timer tick count
+ *         and setting the tick rate and mode
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+/* tick rate set up by handler_install */
+#define TIMER_DEFAULT_HZ 100
+
+/** @brief get_ticks returns the number of timer ticks since boot
+ *
+ *  @return unsigned the tick count
+ */
+unsigned int get_ticks();
+
+/** @brief timer_set_rate sets the number of ticks per second
+ *
+ *  @param hz The tick rate; the PIT takes rates from 19 Hz up
+ *  @return int 0 on success, -1 if the rate is out of range
+ */
+int timer_set_rate(unsigned int hz);
+
+/** @brief timer_get_rate returns the number of ticks per second
+ *
+ *  @return unsigned the tick rate in Hz
+ */
+unsigned int timer_get_rate();
+
+/** @brief timer_tickless switches between periodic and tickless mode
+ *
+ *  In tickless mode the timer only interrupts for deadlines set
+ *  with timer_deadline(), so the tick count stands still while
+ *  none is pending. Leaving tickless mode drops the deadline. The
+ *  tick callback still sees every tick, but the ticks a shot covers
+ *  are all delivered at once, when its interrupt arrives.
+ *
+ *  @param on Nonzero for tickless mode, 0 for periodic mode
+ *  @return Void.
+ */
+void timer_tickless(int on);
+
+/** @brief timer_deadline asks for a timer interrupt in tickless mode
+ *
+ *  Only the earliest pending deadline is kept, so a caller waiting
+ *  for a later one has to ask again after each interrupt. Does
+ *  nothing in periodic mode, where every tick interrupts anyway.
+ *
+ *  @param ticks The number of ticks from now, at least 1
+ *  @return Void.
+ */
+void timer_deadline(unsigned int ticks);
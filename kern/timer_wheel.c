@@ -0,0 +1,272 @@
+/** @file timer_wheel.c
+ *  @brief the file contains the software timers
+ *
+ *  The wheel has WHEEL_LEVELS levels of WHEEL_SIZE slots. A level 0
+ *  slot holds the timers expiring on one tick; a slot of level n
+ *  holds those expiring within a range WHEEL_SIZE^n ticks long.
+ *  Whenever the lower levels wrap around, the next slot of the level
+ *  above is emptied into them, so a timer is moved at most once per
+ *  level before it expires.
+ *
+ *  Each slot is a circular doubly linked list with its own head,
+ *  so a timer can be unlinked without searching for it. Timers are
+ *  taken from a fixed pool; the id handed out carries a generation
+ *  count so a stale id cannot cancel the timer's next user.
+ *
+ *  @author Sohil Habib (snhabib)
+ *  @bug No known bugs.
+ */
+
+/* necessary includes */
+#include <stdint.h>
+#include <x86/asm.h>
+#include <x86/eflags.h>
+#include <timer_handler.h>
+#include <timer_wheel.h>
+
+/* bits of the expiry tick resolved by each level */
+#define WHEEL_BITS 6
+
+/* slots per level */
+#define WHEEL_SIZE (1<<WHEEL_BITS)
+
+/* turns a tick into a slot of level 0 */
+#define WHEEL_MASK (WHEEL_SIZE-1)
+
+/* number of levels */
+#define WHEEL_LEVELS 4
+
+/* ticks covered by the whole wheel */
+#define WHEEL_RANGE (1u<<(WHEEL_BITS*WHEEL_LEVELS))
+
+/* bits of an id holding the pool index */
+#define ID_SHIFT 8
+
+/* the slot of a level the given tick falls in */
+#define SLOT(tick,level) (((tick)>>(WHEEL_BITS*(level))) & WHEEL_MASK)
+
+/** @brief a pending timer, or a slot's list head */
+typedef struct wtimer {
+  struct wtimer *next;
+  struct wtimer *prev;
+  /* the tick the timer expires at */
+  unsigned int expires;
+  void (*fn)(void *);
+  void *arg;
+  /* the id handed out for the timer, -1 while it is free */
+  int id;
+} wtimer_t;
+
+/* the timer pool */
+static wtimer_t timers[MAX_TIMERS];
+
+/* unused timers, linked through next */
+static wtimer_t *free_timers;
+
+/* the list heads of every slot */
+static wtimer_t wheel[WHEEL_LEVELS][WHEEL_SIZE];
+
+/* the next tick the wheel has to process */
+static unsigned int wheel_time;
+
+/* counts the ids handed out */
+static unsigned int generation;
+
+/* the number of pending timers */
+static int num_pending;
+
+static void list_init(wtimer_t *head)
+{
+  head->next=head;
+  head->prev=head;
+}
+
+static int list_empty(wtimer_t *head)
+{
+  return head->next==head;
+}
+
+static void list_add(wtimer_t *head,wtimer_t *t)
+{
+  t->next=head;
+  t->prev=head->prev;
+  head->prev->next=t;
+  head->prev=t;
+}
+
+static void list_del(wtimer_t *t)
+{
+  t->prev->next=t->next;
+  t->next->prev=t->prev;
+}
+
+/** @brief moves every timer of one list onto an empty one
+ *
+ *  @param to The empty list head to move the timers to
+ *  @param from The list head to take them from
+ *  @return Void.
+ */
+static void list_move(wtimer_t *to,wtimer_t *from)
+{
+  list_init(to);
+  if(list_empty(from))
+    return;
+  to->next=from->next;
+  to->prev=from->prev;
+  to->next->prev=to;
+  to->prev->next=to;
+  list_init(from);
+}
+
+/** @brief puts a timer in the slot its expiry falls in
+ *
+ *  @param t The timer
+ *  @return Void.
+ */
+static void place(wtimer_t *t)
+{
+  unsigned int delta=t->expires-wheel_time;
+  int level=0;
+  if((int)delta<0) {
+    delta=0;
+    t->expires=wheel_time;
+  }
+  if(delta>=WHEEL_RANGE) {
+    delta=WHEEL_RANGE-1;
+    t->expires=wheel_time+delta;
+  }
+  while(delta>>(WHEEL_BITS*(level+1)))
+    level++;
+  list_add(&wheel[level][SLOT(t->expires,level)],t);
+}
+
+/** @brief moves the timers of a slot down to the levels below it
+ *
+ *  @param level The level of the slot
+ *  @param idx The slot
+ *  @return Void.
+ */
+static void cascade(int level,int idx)
+{
+  wtimer_t list;
+  wtimer_t *t;
+  list_move(&list,&wheel[level][idx]);
+  while(!list_empty(&list)) {
+    t=list.next;
+    list_del(t);
+    place(t);
+  }
+}
+
+/** @brief returns a timer to the pool
+ *
+ *  @param t The timer, already unlinked
+ *  @return Void.
+ */
+static void release(wtimer_t *t)
+{
+  t->id=-1;
+  t->next=free_timers;
+  free_timers=t;
+  num_pending--;
+}
+
+void timer_wheel_init(unsigned int now)
+{
+  int i,j;
+  for(i=0;i<WHEEL_LEVELS;i++)
+    for(j=0;j<WHEEL_SIZE;j++)
+      list_init(&wheel[i][j]);
+  free_timers=0;
+  for(i=MAX_TIMERS-1;i>=0;i--) {
+    timers[i].id=-1;
+    timers[i].next=free_timers;
+    free_timers=&timers[i];
+  }
+  num_pending=0;
+  wheel_time=now+1;
+}
+
+int timer_add(unsigned int ticks,void (*fn)(void *),void *arg)
+{
+  uint32_t flags=get_eflags();
+  wtimer_t *t;
+  int id;
+  if(!ticks)
+    ticks=1;
+  disable_interrupts();
+  t=free_timers;
+  if(!t) {
+    set_eflags(flags);
+    return -1;
+  }
+  free_timers=t->next;
+  generation++;
+  id=((generation<<ID_SHIFT) & 0x7FFFFFFF) | (t-timers);
+  t->id=id;
+  t->expires=get_ticks()+ticks;
+  t->fn=fn;
+  t->arg=arg;
+  place(t);
+  num_pending++;
+  // in tickless mode the timer has to ask for its interrupt
+  timer_deadline(ticks);
+  set_eflags(flags);
+  return id;
+}
+
+int timer_cancel(int id)
+{
+  uint32_t flags;
+  wtimer_t *t;
+  if(id<0 || (id & ((1<<ID_SHIFT)-1))>=MAX_TIMERS)
+    return -1;
+  t=&timers[id & ((1<<ID_SHIFT)-1)];
+  flags=get_eflags();
+  disable_interrupts();
+  if(t->id!=id) {
+    set_eflags(flags);
+    return -1;
+  }
+  list_del(t);
+  release(t);
+  set_eflags(flags);
+  return 0;
+}
+
+void timer_wheel_run(unsigned int now)
+{
+  wtimer_t due;
+  wtimer_t *t;
+  void (*fn)(void *);
+  void *arg;
+  int level;
+  while((int)(now-wheel_time)>=0) {
+    // each level wraps when all the levels below it do
+    for(level=1;level<WHEEL_LEVELS && !SLOT(wheel_time,level-1);level++)
+      cascade(level,SLOT(wheel_time,level));
+    list_move(&due,&wheel[0][SLOT(wheel_time,0)]);
+    wheel_time++;
+    // a callback may add or cancel timers, even ones still in due
+    while(!list_empty(&due)) {
+      t=due.next;
+      fn=t->fn;
+      arg=t->arg;
+      list_del(t);
+      release(t);
+      fn(arg);
+    }
+  }
+}
+
+unsigned int timer_wheel_next(unsigned int now)
+{
+  unsigned int tick=wheel_time;
+  int i;
+  if(!num_pending)
+    return 0;
+  for(i=0;i<WHEEL_SIZE;i++,tick++)
+    if(!SLOT(tick,0) || !list_empty(&wheel[0][SLOT(tick,0)]))
+      break;
+  return (int)(tick-now)>0 ? tick-now : 1;
+}
@@ -0,0 +1,62 @@
+/** @file timer_wheel.h
+ *  @brief function definition for the software timers
+ *
+ *  Timers are kept in a hierarchical timer wheel driven by the
+ *  timer handler, so adding, cancelling and expiring a timer each
+ *  take constant time. Callbacks run in interrupt context.
+ *
+ *  @author Sohil Habib (snhabib)
+ */
+
+/* number of timers that can be pending at once */
+#define MAX_TIMERS 32
+
+/** @brief timer_add calls a function after the given number of ticks
+ *
+ *  A periodic timer is made by adding the timer again from its own
+ *  callback. Timers further out than the wheel reaches, about 2^24
+ *  ticks, expire at its far end.
+ *
+ *  @param ticks The number of ticks from now, at least 1
+ *  @param fn The function to call
+ *  @param arg The argument to call fn with
+ *  @return int an id for timer_cancel, -1 if too many timers are
+ *          pending
+ */
+int timer_add(unsigned int ticks,void (*fn)(void *),void *arg);
+
+/** @brief timer_cancel stops a pending timer
+ *
+ *  @param id The id returned by timer_add
+ *  @return int 0 if the timer was stopped, -1 if it has already
+ *          expired or been cancelled
+ */
+int timer_cancel(int id);
+
+/** @brief sets up an empty wheel
+ *
+ *  @param now The current tick
+ *  @return Void.
+ */
+void timer_wheel_init(unsigned int now);
+
+/** @brief expires every timer due up to the given tick
+ *
+ *  Called by the timer handler. Ticks skipped over in tickless
+ *  mode are caught up one at a time.
+ *
+ *  @param now The current tick
+ *  @return Void.
+ */
+void timer_wheel_run(unsigned int now);
+
+/** @brief returns how long the wheel can go without being run
+ *
+ *  This is the time to the next expiry, or to the next time timers
+ *  have to move down the wheel if that comes first.
+ *
+ *  @param now The current tick
+ *  @return unsigned the number of ticks from now, 0 if no timer
+ *          is pending
+ */
+unsigned int timer_wheel_next(unsigned int now);